@@ -0,0 +1,519 @@
+--[[
+
+  bench/bench.lua
+  lua-buffer
+
+  benchmark and regression harness.
+
+  usage: lua bench/bench.lua [options]
+
+    --min <size>        minimum payload size. (default: 16)
+    --max <size>        maximum payload size. (default: 16M)
+    --filter <pattern>  run only the cases that matches the lua pattern.
+    --time <sec>        minimum measuring time of each case. (default: 0.2)
+    --out <file>        output file. (default: bench_output.txt)
+    --baseline <file>   baseline file. (default: bench/baseline.tsv)
+    --threshold <pct>   allowed slowdown against the baseline. (default: 10)
+    --save              save the results as the baseline.
+
+  size can be specified with K, M or G suffix. (e.g. 1G)
+
+  the results are written as tab separated values;
+
+    name<TAB>size<TAB>ops/sec<TAB>bytes/sec
+
+  exit status is 1 if any case is slower than the baseline more than the
+  threshold.
+
+  the fd benchmarks require luaposix for pipe and socketpair.
+
+--]]
+local buffer = require('buffer');
+local clock = os.clock;
+local posix = {};
+local OPTS = {
+    min = 16,
+    max = 16 * 1024 * 1024,
+    filter = nil,
+    time = 0.2,
+    out = 'bench_output.txt',
+    baseline = 'bench/baseline.tsv',
+    threshold = 10,
+    save = false
+};
+local CASES = {};
+
+
+local function toSize( str )
+    local n, unit = str:match( '^(%d+)([KkMmGg]?)$' );
+    
+    n = assert( tonumber( n ), 'invalid size: ' .. str );
+    unit = unit:upper();
+    if unit == 'K' then
+        return n * 1024;
+    elseif unit == 'M' then
+        return n * 1024 * 1024;
+    elseif unit == 'G' then
+        return n * 1024 * 1024 * 1024;
+    end
+    
+    return n;
+end
+
+
+local function parseArgs( argv )
+    local i = 1;
+    
+    while argv[i] do
+        local name = argv[i]:match('^%-%-(%w+)$');
+        
+        if name == 'save' then
+            OPTS.save = true;
+        elseif name and OPTS[name] ~= nil or name == 'filter' then
+            i = i + 1;
+            assert( argv[i], 'missing value of --' .. name );
+            if name == 'min' or name == 'max' then
+                OPTS[name] = toSize( argv[i] );
+            elseif name == 'time' or name == 'threshold' then
+                OPTS[name] = assert( tonumber( argv[i] ) );
+            else
+                OPTS[name] = argv[i];
+            end
+        else
+            error( 'unknown option: ' .. argv[i] );
+        end
+        i = i + 1;
+    end
+end
+
+
+local function sizes()
+    local list = {};
+    local size = 16;
+    
+    while size <= OPTS.max do
+        if size >= OPTS.min then
+            list[#list + 1] = size;
+        end
+        size = size * 16;
+        -- include 1G
+        if size > OPTS.max and size / 4 <= OPTS.max and 
+           list[#list] ~= OPTS.max then
+            size = OPTS.max;
+        end
+    end
+    
+    return list;
+end
+
+
+-- register a case.
+-- setup( size ) returns the state and the function that run once.
+local function case( name, setup )
+    CASES[#CASES + 1] = { name = name, setup = setup };
+end
+
+
+local function payload( size )
+    local unit = 'abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789';
+    
+    return unit:rep( math.ceil( size / #unit ) ):sub( 1, size );
+end
+
+
+local function newbuf( size, data )
+    local b = assert( buffer.new( size > 4096 and 4096 or size ) );
+    
+    if data then
+        assert( not b:set( data ) );
+    end
+    
+    return b;
+end
+
+
+-- measure the number of calls per second
+local function measure( fn, size )
+    local n = 1;
+    local elapsed = 0;
+    
+    -- warmup
+    fn();
+    repeat
+        local t = clock();
+        
+        for _ = 1, n do
+            fn();
+        end
+        elapsed = clock() - t;
+        if elapsed < OPTS.time then
+            n = n * ( elapsed > 0 and 
+                      math.min( 10, math.ceil( OPTS.time * 1.2 / elapsed ) ) or 
+                      10 );
+        end
+    until elapsed >= OPTS.time or n * size > 64 * 1024 * 1024 * 1024;
+    
+    return n / elapsed;
+end
+
+
+-- buffer methods
+case( 'buffer.add', function( size )
+    local b = newbuf( size );
+    local data = payload( 16 );
+    local n = size / 16;
+    
+    return function()
+        b:set('');
+        for _ = 1, n do
+            b:add( data );
+        end
+    end;
+end);
+
+case( 'table.concat', function( size )
+    local data = payload( 16 );
+    local n = size / 16;
+    
+    return function()
+        local t = {};
+        
+        for i = 1, n do
+            t[i] = data;
+        end
+        return table.concat( t );
+    end;
+end);
+
+case( 'buffer.insert', function( size )
+    local b = newbuf( size * 2 );
+    local data = payload( size );
+    
+    return function()
+        b:set( data );
+        b:insert( 1, data );
+    end;
+end);
+
+case( 'buffer.set', function( size )
+    local b = newbuf( size );
+    local data = payload( size );
+    
+    return function()
+        b:set( data );
+    end;
+end);
+
+case( 'buffer.sub', function( size )
+    local b = newbuf( size, payload( size ) );
+    
+    return function()
+        return b:sub( 2 );
+    end;
+end);
+
+case( 'string.sub', function( size )
+    local s = payload( size );
+    
+    return function()
+        return s:sub( 2 );
+    end;
+end);
+
+case( 'buffer.substr', function( size )
+    local b = newbuf( size, payload( size ) );
+    
+    return function()
+        return b:substr( 2, size - 2 );
+    end;
+end);
+
+case( 'buffer.byte', function( size )
+    local b = newbuf( size, payload( size ) );
+    local n = size < 16 and size or 16;
+    
+    return function()
+        return b:byte( 1, n );
+    end;
+end);
+
+case( 'string.byte', function( size )
+    local s = payload( size );
+    local n = size < 16 and size or 16;
+    
+    return function()
+        return s:byte( 1, n );
+    end;
+end);
+
+case( 'buffer.lower', function( size )
+    local b = newbuf( size, payload( size ) );
+    
+    return function()
+        return b:lower();
+    end;
+end);
+
+case( 'string.lower', function( size )
+    local s = payload( size );
+    
+    return function()
+        return s:lower();
+    end;
+end);
+
+case( 'buffer.upper', function( size )
+    local b = newbuf( size, payload( size ) );
+    
+    return function()
+        return b:upper();
+    end;
+end);
+
+case( 'string.upper', function( size )
+    local s = payload( size );
+    
+    return function()
+        return s:upper();
+    end;
+end);
+
+case( 'buffer.hex', function( size )
+    local b = newbuf( size, payload( size ) );
+    
+    return function()
+        return b:hex();
+    end;
+end);
+
+case( 'string.hex', function( size )
+    local s = payload( size );
+    local fmt = string.format;
+    local byte = string.byte;
+    
+    return function()
+        return ( s:gsub( '.', function( c )
+            return fmt( '%02x', byte( c ) );
+        end ) );
+    end;
+end);
+
+case( 'buffer.base64', function( size )
+    local b = newbuf( size, payload( size ) );
+    
+    return function()
+        return b:base64();
+    end;
+end);
+
+case( 'buffer.base64url', function( size )
+    local b = newbuf( size, payload( size ) );
+    
+    return function()
+        return b:base64url();
+    end;
+end);
+
+case( 'buffer.tostring', function( size )
+    local b = newbuf( size, payload( size ) );
+    
+    return function()
+        return tostring( b );
+    end;
+end);
+
+
+-- fd benchmarks
+local function fdpair( kind )
+    local fcntl = posix.fcntl;
+    local r, w;
+    
+    if kind == 'pipe' then
+        r, w = posix.unistd.pipe();
+    else
+        local sock = posix.socket;
+        r, w = sock.socketpair( sock.AF_UNIX, sock.SOCK_STREAM, 0 );
+    end
+    assert( r, w );
+    -- writer must not be blocked by the capacity of the pair
+    for _, fd in ipairs({ r, w }) do
+        local flags = fcntl.fcntl( fd, fcntl.F_GETFL );
+        fcntl.fcntl( fd, fcntl.F_SETFL, flags + fcntl.O_NONBLOCK );
+    end
+    
+    return r, w;
+end
+
+
+-- read until remain bytes or EAGAIN
+local function drain( dst, op, remain )
+    while remain > 0 do
+        local n, err, again = dst[op]( dst, 65536 );
+        
+        if n > 0 then
+            remain = remain - n;
+        elseif not again then
+            error( err or 'closed' );
+        else
+            break;
+        end
+    end
+    
+    return remain;
+end
+
+
+local function fdcase( kind )
+    -- write size bytes by flush and read them by read.
+    case( 'buffer.flush/read.' .. kind, function( size )
+        local r, w = fdpair( kind );
+        local src = newbuf( size, payload( size ) );
+        local dst = newbuf( 65536 );
+        local data = tostring( src );
+        
+        src:setfd( w, true );
+        dst:setfd( r, true );
+        return function()
+            local remain = size;
+            
+            src:set( data );
+            repeat
+                local _, _, err, again = src:flush();
+                
+                assert( not err or again, err );
+                remain = drain( dst, 'read', remain );
+            until remain == 0;
+        end;
+    end);
+    
+    -- write size bytes by write and append them by readadd.
+    case( 'buffer.write/readadd.' .. kind, function( size )
+        local r, w = fdpair( kind );
+        local src = newbuf( 16 );
+        local dst = newbuf( size );
+        local data = payload( size < 65536 and size or 65536 );
+        local n = math.ceil( size / #data );
+        
+        src:setfd( w, true );
+        dst:setfd( r, true );
+        return function()
+            dst:set('');
+            for _ = 1, n do
+                local off = 1;
+                
+                repeat
+                    local len, err, again = src:write( data:sub( off ) );
+                    
+                    if len > 0 then
+                        off = off + len;
+                        drain( dst, 'readadd', len );
+                    else
+                        assert( again, err );
+                    end
+                until off > #data;
+            end
+        end;
+    end);
+end
+
+
+local function loadPosix()
+    local ok, unistd = pcall( require, 'posix.unistd' );
+    
+    if ok then
+        posix.unistd = unistd;
+        ok, posix.socket = pcall( require, 'posix.sys.socket' );
+        if ok then
+            ok, posix.fcntl = pcall( require, 'posix.fcntl' );
+        end
+        if ok then
+            fdcase( 'pipe' );
+            fdcase( 'socketpair' );
+            return;
+        end
+    end
+    
+    io.stderr:write( 'luaposix not found: skip fd benchmarks\n' );
+end
+
+
+local function readBaseline( pathname )
+    local f = io.open( pathname );
+    local baseline = {};
+    
+    if f then
+        for line in f:lines() do
+            local name, size, ops = line:match('^([^\t]+)\t(%d+)\t([^\t]+)\t');
+            
+            if name then
+                baseline[name .. '\t' .. size] = tonumber( ops );
+            end
+        end
+        f:close();
+    end
+    
+    return baseline;
+end
+
+
+local function run()
+    local baseline = readBaseline( OPTS.baseline );
+    local out = assert( io.open( OPTS.out, 'w' ) );
+    local nregress = 0;
+    
+    for _, c in ipairs( CASES ) do
+        if not OPTS.filter or c.name:find( OPTS.filter ) then
+            for _, size in ipairs( sizes() ) do
+                local ok, fn = pcall( c.setup, size );
+                
+                if not ok then
+                    io.stderr:write( ('%-28s %12d  skip: %s\n'):format( 
+                        c.name, size, tostring( fn ) 
+                    ));
+                else
+                    local ops = measure( fn, size );
+                    local key = c.name .. '\t' .. size;
+                    local base = baseline[key];
+                    local diff = '';
+                    
+                    out:write( ('%s\t%d\t%.3f\t%.0f\n'):format( 
+                        c.name, size, ops, ops * size 
+                    ));
+                    if base then
+                        local pct = ( ops - base ) / base * 100;
+                        
+                        diff = ('%+7.1f%%'):format( pct );
+                        if pct < -OPTS.threshold then
+                            diff = diff .. ' REGRESSION';
+                            nregress = nregress + 1;
+                        end
+                    end
+                    print( ('%-28s %12d %14.1f ops/s %10.1f MB/s %s'):format( 
+                        c.name, size, ops, ops * size / 1024 / 1024, diff 
+                    ));
+                end
+                collectgarbage();
+            end
+        end
+    end
+    out:close();
+    
+    if OPTS.save then
+        local src = assert( io.open( OPTS.out ) );
+        local dst = assert( io.open( OPTS.baseline, 'w' ) );
+        
+        dst:write( src:read('*a') );
+        src:close();
+        dst:close();
+        print( 'baseline saved to ' .. OPTS.baseline );
+    end
+    
+    return nregress;
+end
+
+
+parseArgs( arg or {} );
+loadPosix();
+if run() > 0 then
+    os.exit( 1 );
+end
@@ -0,0 +1,142 @@
+--[[
+
+  Copyright (C) 2026 Masatoshi Teruya
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+  lib/buffer/ffi.lua
+  lua-buffer
+
+  fast path of the byte access and the small appends for LuaJIT.
+  the functions fall back to the methods on the other Lua implementations.
+
+--]]
+local buffer = require('buffer');
+local MT = getmetatable( buffer.new( 1 ) );
+local ok, ffi = pcall( require, 'ffi' );
+
+-- fallback
+if not ok then
+    return {
+        enabled = false,
+        ptr = function()
+            return nil;
+        end,
+        len = function( b )
+            if getmetatable( b ) ~= MT then
+                error( 'buffer expected', 2 );
+            end
+            return #b;
+        end,
+        byte = function( b, i )
+            return b:byte( i );
+        end,
+        add = function( b, str )
+            return b:add( str );
+        end
+    };
+end
+
+
+-- public fields of buf_t in src/lua_buffer.h
+ffi.cdef[[
+typedef struct {
+    int fd;
+    int cloexec;
+    size_t cur;
+    size_t unit;
+    size_t nmax;
+    size_t nalloc;
+    size_t used;
+    size_t total;
+    unsigned char *mem;
+    size_t gen;
+    size_t wmhigh;
+    size_t opend;
+} lua_buffer_t;
+]];
+
+local BUFPTR = ffi.typeof('lua_buffer_t*');
+local copy = ffi.copy;
+local cast = ffi.cast;
+local tonumber = tonumber;
+local getmetatable = getmetatable;
+local error = error;
+
+
+local function ptr( b )
+    local p;
+
+    if getmetatable( b ) ~= MT then
+        error( 'buffer expected', 2 );
+    end
+
+    p = cast( BUFPTR, b );
+    if p.mem == nil then
+        error( 'attempted to access already freed memory', 2 );
+    end
+
+    return p;
+end
+
+
+local function len( b )
+    return tonumber( ptr( b ).used );
+end
+
+
+local function byte( b, i )
+    local p = ptr( b );
+
+    i = i or 1;
+    if i < 1 or i > tonumber( p.used ) then
+        return nil;
+    end
+
+    return p.mem[i - 1];
+end
+
+
+local function add( b, str )
+    local p = ptr( b );
+    local n = #str;
+    local used = p.used;
+
+    -- append in place if the space (and the null-terminator) is sufficient.
+    -- the method counts the bytes of the watermarks, and checks the
+    -- asynchronous operation
+    if p.total - used > n and p.wmhigh == 0 and p.opend <= used then
+        copy( p.mem + used, str, n );
+        p.used = used + n;
+        p.mem[used + n] = 0;
+        p.gen = p.gen + 1;
+        return;
+    end
+
+    return b:add( str );
+end
+
+
+return {
+    enabled = true,
+    ptr = ptr,
+    len = len,
+    byte = byte,
+    add = add
+};
@@ -0,0 +1,174 @@
+/*
+ *  Copyright 2026 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  acmatch.h
+ *  Created by Masatoshi Teruya on 26/10/18.
+ *
+ *  multi-pattern matcher of the Aho-Corasick automaton.
+ *
+ */
+
+#ifndef ACMATCH_H
+#define ACMATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+
+
+typedef struct {
+    // number of states. state 0 is the root
+    uint32_t nstate;
+    // transition table of nstate * 256 entries
+    uint32_t *delta;
+    // index + 1 of the longest pattern that is a suffix of the state, or 0
+    uint32_t *out;
+    // length of the string of the state
+    uint32_t *depth;
+    // length of the patterns
+    size_t npat;
+    size_t *plen;
+    size_t maxlen;
+} acm_t;
+
+
+static inline void acm_free( acm_t *acm )
+{
+    free( acm->delta );
+    free( acm->out );
+    free( acm->depth );
+    free( acm->plen );
+    acm->delta = NULL;
+    acm->out = acm->depth = NULL;
+    acm->plen = NULL;
+}
+
+
+// compile the automaton of npat patterns.
+// every pattern must not be empty. returns -1 with errno on failure.
+static inline int acm_compile( acm_t *acm, const unsigned char **pats,
+                               const size_t *lens, size_t npat )
+{
+    size_t max = 1;
+    uint32_t *fail = NULL;
+    uint32_t *queue = NULL;
+    uint32_t head = 0;
+    uint32_t tail = 0;
+    size_t i = 0;
+
+    *acm = (acm_t){ 0 };
+    for(; i < npat; i++ ){
+        max += lens[i];
+        if( max > UINT32_MAX / 256 ){
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+
+    if( !( acm->delta = calloc( max * 256, sizeof( uint32_t ) ) ) ||
+        !( acm->out = calloc( max, sizeof( uint32_t ) ) ) ||
+        !( acm->depth = calloc( max, sizeof( uint32_t ) ) ) ||
+        !( acm->plen = malloc( ( npat + 1 ) * sizeof( size_t ) ) ) ||
+        !( fail = calloc( max, sizeof( uint32_t ) ) ) ||
+        !( queue = malloc( max * sizeof( uint32_t ) ) ) ){
+        free( fail );
+        acm_free( acm );
+        return -1;
+    }
+
+    // trie. 0 is used as the missing edge since no edge goes to the root
+    acm->nstate = 1;
+    acm->npat = npat;
+    for( i = 0; i < npat; i++ )
+    {
+        uint32_t s = 0;
+        size_t j = 0;
+
+        for(; j < lens[i]; j++ )
+        {
+            uint32_t *next = acm->delta + (size_t)s * 256 + pats[i][j];
+
+            if( !*next ){
+                *next = acm->nstate;
+                acm->depth[acm->nstate++] = (uint32_t)j + 1;
+            }
+            s = *next;
+        }
+        // the first one is used for the duplicated patterns
+        if( !acm->out[s] ){
+            acm->out[s] = (uint32_t)i + 1;
+        }
+        acm->plen[i] = lens[i];
+        if( lens[i] > acm->maxlen ){
+            acm->maxlen = lens[i];
+        }
+    }
+
+    // fill the failure transitions in breadth-first order
+    for( i = 0; i < 256; i++ ){
+        if( acm->delta[i] ){
+            queue[tail++] = acm->delta[i];
+        }
+    }
+    while( head < tail )
+    {
+        uint32_t s = queue[head++];
+        uint32_t *row = acm->delta + (size_t)s * 256;
+        const uint32_t *frow = acm->delta + (size_t)fail[s] * 256;
+
+        // the longest pattern ending here
+        if( !acm->out[s] ){
+            acm->out[s] = acm->out[fail[s]];
+        }
+        for( i = 0; i < 256; i++ )
+        {
+            if( row[i] ){
+                fail[row[i]] = frow[i];
+                queue[tail++] = row[i];
+            }
+            else {
+                row[i] = frow[i];
+            }
+        }
+    }
+    free( fail );
+    free( queue );
+
+    // release the unused states
+    if( acm->nstate < max )
+    {
+        uint32_t *delta = realloc( acm->delta, (size_t)acm->nstate * 256 *
+                                               sizeof( uint32_t ) );
+        if( delta ){
+            acm->delta = delta;
+        }
+    }
+
+    return 0;
+}
+
+
+// returns the next state
+#define acm_next(acm,s,c)   ((acm)->delta[(size_t)(s) * 256 + (c)])
+
+
+#endif
@@ -50,6 +50,61 @@ static const unsigned char BASE64MIX_URLENC[64] = {
 };
 
 
+// dest length must be greater than the encoded length of len.
+// returns the number of bytes written.
+static inline size_t b64m_encode_to( unsigned char *dest, 
+                                     const unsigned char *src, size_t len, 
+                                     const unsigned char enctbl[] )
+{
+    const unsigned char *cur = src;
+    unsigned char *ptr = dest;
+    uint8_t c = -1;
+    uint8_t state = 0;
+    size_t i = 0;
+    
+    for(; i < len; i++ )
+    {
+        switch( state ){
+            case 0:
+                c = ( *cur >> 2 ) & 0x3f;
+                *ptr++ = enctbl[c];
+                c = ( *cur & 0x3 ) << 4;
+                state = 1;
+            break;
+            case 1:
+                c |= ( *cur >> 4 ) & 0xf;
+                *ptr++ = enctbl[c];
+                c = ( *cur & 0xf ) << 2;
+                state = 2;
+            break;
+            case 2:
+                c |= ( *cur >> 6 ) & 0x3;
+                *ptr++ = enctbl[c];
+                c = *cur & 0x3f;
+                *ptr++ = enctbl[c];
+                c = -1;
+                state = 0;
+            break;
+        }
+        cur++;
+    }
+    
+    // append last bit
+    if( c != (uint8_t)-1 ){
+        *ptr++ = enctbl[c];
+    }
+    // append padding if standard base64
+    if( enctbl == BASE64MIX_STDENC )
+    {
+        while( ( ptr - dest ) % 4 ){
+            *ptr++ = '=';
+        }
+    }
+    
+    return (size_t)( ptr - dest );
+}
+
+
 static inline char *b64m_encode( const unsigned char *src, size_t *len, 
                                  const unsigned char enctbl[] )
 {
@@ -68,55 +123,10 @@ static inline char *b64m_encode( const unsigned char *src, size_t *len,
         return NULL;
     }
     
-    if( ( res = malloc( bytes + 1 ) ) )
-    {
-        const unsigned char *cur = src;
-        unsigned char *ptr = res;
-        uint8_t c = -1;
-        uint8_t state = 0;
-        size_t i = 0;
-        
-        for(; i < tail; i++ )
-        {
-            switch( state ){
-                case 0:
-                    c = ( *cur >> 2 ) & 0x3f;
-                    *ptr++ = enctbl[c];
-                    c = ( *cur & 0x3 ) << 4;
-                    state = 1;
-                break;
-                case 1:
-                    c |= ( *cur >> 4 ) & 0xf;
-                    *ptr++ = enctbl[c];
-                    c = ( *cur & 0xf ) << 2;
-                    state = 2;
-                break;
-                case 2:
-                    c |= ( *cur >> 6 ) & 0x3;
-                    *ptr++ = enctbl[c];
-                    c = *cur & 0x3f;
-                    *ptr++ = enctbl[c];
-                    c = -1;
-                    state = 0;
-                break;
-            }
-            cur++;
-        }
-        
-        // append last bit
-        if( c != (uint8_t)-1 ){
-            *ptr++ = enctbl[c];
-        }
-        // append padding if standard base64
-        if( enctbl == BASE64MIX_STDENC )
-        {
-            for( i = ptr - res; i < bytes; i++ ){
-                *ptr++ = '=';
-            }
-        }
+    if( ( res = malloc( bytes + 1 ) ) ){
         // set result length
-        *len = ptr - res;
-        *ptr = 0;
+        *len = b64m_encode_to( res, src, tail, enctbl );
+        res[*len] = 0;
     }
     
     return (char*)res;
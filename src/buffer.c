@@ -28,18 +28,42 @@
  */
 
 
+// splice(2)
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
 #include <unistd.h>
 #include <stddef.h>
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <limits.h>
+#include <time.h>
 #include <sys/uio.h>
+#include <zlib.h>
+#if defined(BUFFER_USDT)
+#include <sys/sdt.h>
+#endif
 // lua
 #include <lua.h>
 #include <lauxlib.h>
+#include "lua_buffer.h"
 #include "hexcodec.h"
 #include "base64mix.h"
+#include "urlcodec.h"
+#include "utf8valid.h"
+#include "checksum.h"
+#include "ring.h"
+#include "workpool.h"
+#include "acmatch.h"
+#include "bytescan.h"
+#include "httphead.h"
+#include "uring.h"
+#include "zerocopy.h"
+#include "dgram.h"
+#include "logfile.h"
+#include "directio.h"
 
 
 // memory alloc/dealloc
@@ -78,22 +102,174 @@
 }while(0)
 
 
-// do not touch directly
-typedef struct {
-    int fd;
-    int cloexec;
-    size_t cur;
-    // buffer
-    size_t unit;
-    size_t nmax;
-    size_t nalloc;
-    size_t used;
-    size_t total;
-    void *mem;
-} buf_t;
+#define MODULE_MT   LUA_BUFFER_MT
+#define DEFLATER_MT "buffer.deflater"
+#define INFLATER_MT "buffer.inflater"
+#define RING_MT     "buffer.ring"
+#define MATCHER_MT  "buffer.matcher"
+#define URING_MT    "buffer.uring"
+#define LOGWRITER_MT    "buffer.logwriter"
+
+
+#if defined(BUFFER_NO_STATS)
+
+// b is evaluated to keep the callers free of the unused warnings
+#define buf_stat(b,field,n)         do{ (void)(b); }while(0)
+#define buf_stat_alloc(b,from,to)   do{}while(0)
+#define buf_probing()               0
+#define buf_clock()                 0
+#define buf_probe(b,op,bytes,len,start) do{}while(0)
+
+#else
+
+// module-wide aggregate of all buffers.
+// every buffer belongs to one lua_State, so the counters of buf_t are not
+// atomic, but the aggregate may be shared by the lua_States of the threads.
+static bufstats_t BUF_STATS;
+// bytes currently allocated by all buffers
+static uint64_t BUF_STATS_TOTAL;
+
+#define buf_stat(b,field,n) do{ \
+    (b)->stats.field += (n); \
+    __atomic_fetch_add( &BUF_STATS.field, (n), __ATOMIC_RELAXED ); \
+}while(0)
+
+static inline void bufstats_peak( uint64_t *peak, uint64_t val )
+{
+    uint64_t cur = __atomic_load_n( peak, __ATOMIC_RELAXED );
+    
+    while( val > cur && 
+           !__atomic_compare_exchange_n( peak, &cur, val, 1, __ATOMIC_RELAXED, 
+                                         __ATOMIC_RELAXED ) ){}
+}
+
+// allocated bytes of b changed from -> to
+static inline void buf_stat_alloc( buf_t *b, size_t from, size_t to )
+{
+    uint64_t total = 0;
+    
+    if( to > from ){
+        total = __atomic_add_fetch( &BUF_STATS_TOTAL, to - from, 
+                                    __ATOMIC_RELAXED );
+        bufstats_peak( &BUF_STATS.peak, total );
+        if( to > b->stats.peak ){
+            b->stats.peak = to;
+        }
+    }
+    else if( from > to ){
+        __atomic_sub_fetch( &BUF_STATS_TOTAL, from - to, __ATOMIC_RELAXED );
+    }
+}
+
+
+// log-bucketed histograms of the read/writev system calls.
+// each power of 2 is divided into the linear sub-buckets, so the width of a
+// bucket is at most 1/8 of its lower bound. the values less than 16 are
+// counted exactly.
+#define BUF_HIST_SUBBITS    3
+#define BUF_HIST_NSUB       ( 1 << BUF_HIST_SUBBITS )
+#define BUF_HIST_NBUCKET    ( ( 64 - BUF_HIST_SUBBITS + 1 ) * BUF_HIST_NSUB )
+
+enum {
+    BUF_HIST_READ_NSEC = 0,
+    BUF_HIST_READ_BYTES,
+    BUF_HIST_WRITE_NSEC,
+    BUF_HIST_WRITE_BYTES,
+    BUF_HIST_MAX
+};
+
+static uint64_t BUF_HIST[BUF_HIST_MAX][BUF_HIST_NBUCKET];
+
+// BUF_PROBE_HIST: histograms are enabled
+// BUF_PROBE_TRACE: trace callback is registered
+#define BUF_PROBE_HIST  0x1
+#define BUF_PROBE_TRACE 0x2
+static int BUF_PROBE;
+static buffer_trace_t BUF_TRACE_FN;
+static void *BUF_TRACE_CTX;
+
+#define buf_probing()   __atomic_load_n( &BUF_PROBE, __ATOMIC_RELAXED )
+
+static inline uint64_t buf_clock( void )
+{
+    struct timespec ts;
+    
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline void buf_hist( int hist, uint64_t val )
+{
+    int n = (int)val;
+    
+    if( val >= BUF_HIST_NSUB )
+    {
+        // exponent and the top bits below the leading bit
+        int e = 63 - __builtin_clzll( val );
+        
+        n = ( e - BUF_HIST_SUBBITS + 1 ) * BUF_HIST_NSUB + 
+            (int)( ( val >> ( e - BUF_HIST_SUBBITS ) ) & ( BUF_HIST_NSUB - 1 ) );
+    }
+    __atomic_fetch_add( &BUF_HIST[hist][n], 1, __ATOMIC_RELAXED );
+}
+
+// called after the system call that started at start if buf_probing()
+static inline void buf_probe( buf_t *b, int op, size_t bytes, ssize_t len, 
+                              uint64_t start )
+{
+    int err = len == -1 ? errno : 0;
+    int probe = buf_probing();
+    uint64_t nsec = buf_clock() - start;
+    
+    if( probe & BUF_PROBE_HIST )
+    {
+        int hist = op == BUFFER_TRACE_READ ? BUF_HIST_READ_NSEC : 
+                                             BUF_HIST_WRITE_NSEC;
+        
+        buf_hist( hist, nsec );
+        if( len != -1 ){
+            buf_hist( hist + 1, (uint64_t)len );
+        }
+    }
+    if( probe & BUF_PROBE_TRACE )
+    {
+        buffer_trace_t fn = __atomic_load_n( &BUF_TRACE_FN, __ATOMIC_ACQUIRE );
+        
+        if( fn ){
+            fn( BUF_TRACE_CTX, b, op, b->fd, bytes, len, err, nsec );
+        }
+    }
+    errno = err;
+}
+
+static void buf_settrace( buffer_trace_t fn, void *ctx )
+{
+    if( fn ){
+        BUF_TRACE_CTX = ctx;
+        __atomic_store_n( &BUF_TRACE_FN, fn, __ATOMIC_RELEASE );
+        __atomic_fetch_or( &BUF_PROBE, BUF_PROBE_TRACE, __ATOMIC_RELAXED );
+    }
+    else {
+        __atomic_fetch_and( &BUF_PROBE, ~BUF_PROBE_TRACE, __ATOMIC_RELAXED );
+        __atomic_store_n( &BUF_TRACE_FN, NULL, __ATOMIC_RELEASE );
+    }
+}
 
+#endif
 
-#define MODULE_MT   "buffer"
+
+// static probes for perf/bpftrace
+#if defined(BUFFER_USDT)
+#define buf_usdt_entry(b,op,bytes) \
+    DTRACE_PROBE3( buffer, op##__entry, b, (b)->fd, bytes )
+#define buf_usdt_return(b,op,len) \
+    DTRACE_PROBE4( buffer, op##__return, b, (b)->fd, len, \
+                   len == -1 ? errno : 0 )
+#else
+#define buf_usdt_entry(b,op,bytes)  do{}while(0)
+#define buf_usdt_return(b,op,len)   do{}while(0)
+#endif
 
 
 #define checkudata(L) ({ \
@@ -105,35 +281,140 @@ typedef struct {
 })
 
 
+// reallocate the memory to total bytes. the alignment is kept.
+static inline int buf_realloc( buf_t *b, size_t total )
+{
+    void *buf = NULL;
+    
+    buf_stat( b, realloc, 1 );
+    // realloc does not keep the alignment
+    if( b->align )
+    {
+        int rc = posix_memalign( &buf, b->align, total );
+        
+        if( rc != 0 ){
+            errno = rc;
+            return -1;
+        }
+        memcpy( buf, b->mem, b->total < total ? b->total : total );
+        pdealloc( b->mem );
+    }
+    else if( !( buf = realloc( b->mem, total ) ) ){
+        return -1;
+    }
+    buf_stat_alloc( b, b->total, total );
+    b->total = total;
+    b->mem = buf;
+    
+    return 0;
+}
+
+
 static inline int buf_alloc( buf_t *b, size_t nalloc )
 {
     if( nalloc > b->nmax ){
         errno = ENOMEM;
         return -1;
     }
+    // the kernel refers to the memory
+    else if( nalloc > b->nalloc && b->pinned ){
+        errno = EBUSY;
+        return -1;
+    }
     else if( nalloc > b->nalloc )
     {
-        size_t total = nalloc * b->unit;
-        void *buf = realloc( b->mem, total );
-        
-        if( !buf ){
+        if( buf_realloc( b, nalloc * b->unit ) != 0 ){
             return -1;
         }
         b->nalloc = nalloc;
-        b->total = total;
-        b->mem = buf;
     }
     
     return 0;
 }
 
 
+// shrink the memory of the empty buffer to bytes, at least the unit size.
+// returns the number of bytes released.
+static inline size_t buf_shrink( buf_t *b, size_t bytes )
+{
+    size_t nalloc = bytes / b->unit;
+    size_t total = b->total;
+    
+    if( !nalloc ){
+        nalloc = 1;
+    }
+    if( nalloc >= b->nalloc || b->used || b->pinned ||
+        buf_realloc( b, nalloc * b->unit ) != 0 ){
+        return 0;
+    }
+    b->nalloc = nalloc;
+    
+    return total - b->total;
+}
+
+
+// shrink the memory after a full flush if it exceeds the high watermark
+static inline void buf_reclaim( buf_t *b )
+{
+    if( b->memhigh && b->total > b->memhigh ){
+        buf_shrink( b, b->memlow );
+    }
+}
+
+
+// buffers of a lua_State for buffer.trim. the list is stored into the
+// registry with this key.
+#define BUFFER_LIVE_KEY "buffer.live"
+
+typedef struct {
+    buf_t *head;
+} buflist_t;
+
+
+static inline void buf_link( lua_State *L, buf_t *b )
+{
+    buflist_t *list = NULL;
+    
+    lua_getfield( L, LUA_REGISTRYINDEX, BUFFER_LIVE_KEY );
+    list = (buflist_t*)lua_touserdata( L, -1 );
+    lua_pop( L, 1 );
+    b->next = NULL;
+    b->pprev = NULL;
+    if( list )
+    {
+        if( ( b->next = list->head ) ){
+            b->next->pprev = &b->next;
+        }
+        list->head = b;
+        b->pprev = &list->head;
+    }
+}
+
+
+static inline void buf_unlink( buf_t *b )
+{
+    if( b->pprev )
+    {
+        if( ( *b->pprev = b->next ) ){
+            b->next->pprev = b->pprev;
+        }
+        b->next = NULL;
+        b->pprev = NULL;
+    }
+}
+
+
 static inline int buf_increase( buf_t *b, size_t from, size_t bytes )
 {
     if( from > b->used ){
         errno = EINVAL;
         return -1;
     }
+    // the asynchronous operation refers to the contents after from
+    else if( from < b->opend ){
+        errno = EBUSY;
+        return -1;
+    }
     // remain < bytes
     else if( ( b->total - from ) < bytes )
     {
@@ -152,10 +433,172 @@ static inline int buf_increase( buf_t *b, size_t from, size_t bytes )
 }
 
 
+// number of bytes not flushed yet in the buffers with the watermarks
+static size_t BUF_PENDING = 0;
+
+// count the bytes not flushed yet, and update the state of the
+// backpressure of the buffer with the watermarks
+static inline void buf_account( buf_t *b )
+{
+    size_t pending = 0;
+    
+    if( !b->wmhigh ){
+        return;
+    }
+    
+    pending = b->used > b->cur ? b->used - b->cur : 0;
+    if( pending > b->wmpending ){
+        __atomic_fetch_add( &BUF_PENDING, pending - b->wmpending, 
+                            __ATOMIC_RELAXED );
+    }
+    else if( pending < b->wmpending ){
+        __atomic_fetch_sub( &BUF_PENDING, b->wmpending - pending, 
+                            __ATOMIC_RELAXED );
+    }
+    b->wmpending = pending;
+    
+    // hysteresis
+    if( pending > b->wmhigh ){
+        b->wmabove = 1;
+    }
+    else if( pending <= b->wmlow ){
+        b->wmabove = 0;
+    }
+}
+
+
+// remove the buffer from the module total
+static inline void buf_unaccount( buf_t *b )
+{
+    __atomic_fetch_sub( &BUF_PENDING, b->wmpending, __ATOMIC_RELAXED );
+    b->wmpending = 0;
+    b->wmabove = 0;
+}
+
+
 static inline void buf_term( buf_t *b, size_t pos )
 {
     b->used = pos;
     ((char*)b->mem)[b->used] = 0;
+    b->gen++;
+    buf_account( b );
+}
+
+
+enum {
+    BUF_SUM_NONE = 0,
+    BUF_SUM_CRC32C,
+    BUF_SUM_CRC32,
+    BUF_SUM_ADLER32
+};
+
+// the contents after pos will be rewritten.
+// invalidate the states of the incremental scanners that passed over pos.
+static inline void buf_touch( buf_t *b, size_t pos )
+{
+    if( b->u8pos > pos ){
+        b->u8pos = 0;
+    }
+    if( b->sumpos > pos ){
+        b->sumpos = 0;
+        b->sumalgo = BUF_SUM_NONE;
+    }
+    if( b->httppos > pos ){
+        b->httppos = 0;
+    }
+    if( b->matchpos > pos ){
+        b->matchpos = 0;
+    }
+    // discard the datagrams that end after pos
+    if( !pos ){
+        b->nmsg = 0;
+    }
+    while( b->nmsg && b->msgoff[b->nmsg - 1] + b->msglen[b->nmsg - 1] > pos ){
+        b->nmsg--;
+    }
+    b->gen++;
+}
+
+
+// kinds of the strings made of the contents
+enum {
+    BUF_CACHE_STR = 0,
+    BUF_CACHE_HEX,
+    BUF_CACHE_BASE64,
+    BUF_CACHE_BASE64URL,
+    BUF_CACHE_NONE
+};
+
+// push the string of kind made of the current contents, or returns 0 if it
+// has not been cached.
+static inline int buf_cached( lua_State *L, buf_t *b, int kind )
+{
+    if( kind != BUF_CACHE_NONE && b->cacheref[kind] != LUA_NOREF && 
+        b->cachegen[kind] == b->gen ){
+        lua_rawgeti( L, LUA_REGISTRYINDEX, b->cacheref[kind] );
+        return 1;
+    }
+    
+    return 0;
+}
+
+// the string at the top of the stack is cached when the same kind of string
+// is made again from the unchanged contents, so that the buffers that are
+// stringified only once do not retain the strings.
+static inline void buf_cache( lua_State *L, buf_t *b, int kind )
+{
+    if( kind == BUF_CACHE_NONE ){
+        return;
+    }
+    else if( b->cacheref[kind] != LUA_NOREF ){
+        luaL_unref( L, LUA_REGISTRYINDEX, b->cacheref[kind] );
+        b->cacheref[kind] = LUA_NOREF;
+    }
+    else if( b->cachegen[kind] == b->gen ){
+        lua_pushvalue( L, -1 );
+        b->cacheref[kind] = luaL_ref( L, LUA_REGISTRYINDEX );
+        return;
+    }
+    b->cachegen[kind] = b->gen;
+}
+
+// release the cached strings
+static inline void buf_uncache( lua_State *L, buf_t *b )
+{
+    int i = 0;
+    
+    for(; i < BUF_CACHE_NONE; i++ ){
+        luaL_unref( L, LUA_REGISTRYINDEX, b->cacheref[i] );
+        b->cacheref[i] = LUA_NOREF;
+        b->cachegen[i] = 0;
+    }
+}
+
+// release the cached strings made of the previous contents. they are kept
+// until the same kind of string is made again otherwise.
+static inline void buf_uncache_stale( lua_State *L, buf_t *b )
+{
+    int i = 0;
+    
+    for(; i < BUF_CACHE_NONE; i++ ){
+        if( b->cacheref[i] != LUA_NOREF && b->cachegen[i] != b->gen ){
+            luaL_unref( L, LUA_REGISTRYINDEX, b->cacheref[i] );
+            b->cacheref[i] = LUA_NOREF;
+        }
+    }
+}
+
+
+// returns -1 with EBUSY if the contents after pos are referred by the
+// kernel for the zero-copy sends or the asynchronous operation.
+static inline int buf_writable( buf_t *b, size_t pos )
+{
+    if( pos < b->zcend || pos < b->opend ){
+        errno = EBUSY;
+        return -1;
+    }
+    
+    return 0;
 }
 
 
@@ -163,18 +606,88 @@ static inline ssize_t buf_read( buf_t *b, size_t pos, size_t bytes )
 {
     ssize_t len = 0;
     
+    // the direct I/O reads the multiple of the block size
+    if( b->direct ){
+        bytes = bytes > SIZE_MAX - b->align ? SIZE_MAX :
+                ( bytes + b->align - 1 ) & ~( b->align - 1 );
+    }
+    
     // check arguments
-    if( buf_increase( b, pos, bytes + 1 ) != 0 ){
+    if( buf_writable( b, pos ) != 0 || 
+        buf_increase( b, pos, bytes + 1 ) != 0 ){
         len = -1;
     }
-    else if( ( len = read( b->fd, b->mem + pos, bytes ) ) > 0 ){
-        buf_term( b, pos + (size_t)len );
+    else
+    {
+        uint64_t start = buf_probing() ? buf_clock() : 0;
+        
+        buf_touch( b, pos );
+        buf_stat( b, reads, 1 );
+        buf_usdt_entry( b, read, bytes );
+        if( b->direct ){
+            len = dio_read( b->fd, b->mem + pos, bytes, b->align );
+        }
+        else {
+            len = read( b->fd, b->mem + pos, bytes );
+        }
+        buf_usdt_return( b, read, len );
+        if( start ){
+            buf_probe( b, BUFFER_TRACE_READ, bytes, len, start );
+        }
+        
+        if( len > 0 ){
+            buf_term( b, pos + (size_t)len );
+        }
+        else if( len == -1 && ( errno == EAGAIN || errno == EWOULDBLOCK ) ){
+            buf_stat( b, again, 1 );
+        }
+    }
+    
+    return len;
+}
+
+
+static inline ssize_t buf_writev( buf_t *b, int fd, struct iovec *iov )
+{
+    ssize_t len = 0;
+    uint64_t start = buf_probing() ? buf_clock() : 0;
+    
+    buf_stat( b, writes, 1 );
+    buf_usdt_entry( b, write, iov->iov_len );
+    if( b->direct && fd == b->fd ){
+        len = dio_write( fd, iov->iov_base, iov->iov_len, b->align );
+    }
+    else {
+        len = writev( fd, iov, 1 );
+    }
+    buf_usdt_return( b, write, len );
+    if( start ){
+        buf_probe( b, BUFFER_TRACE_WRITE, iov->iov_len, len, start );
+    }
+    if( len == -1 )
+    {
+        if( errno == EAGAIN || errno == EWOULDBLOCK ){
+            buf_stat( b, again, 1 );
+        }
+    }
+    else if( (size_t)len < iov->iov_len ){
+        buf_stat( b, shortwrites, 1 );
     }
     
     return len;
 }
 
 
+// exported to the other C modules via lua_buffer.h
+static const lbuf_api_t BUF_API = {
+    .version = LUA_BUFFER_API_VERSION,
+    .increase = buf_increase,
+    .term = buf_term,
+    .touch = buf_touch,
+    .writable = buf_writable
+};
+
+
 static int raw_lua( lua_State *L )
 {
     buf_t *b = checkudata( L );
@@ -224,6 +737,9 @@ static int byte_lua( lua_State *L )
     lua_settop( L, 0 );
     head--;
     ret = tail - head;
+    if( ret > INT_MAX || !lua_checkstack( L, (int)ret ) ){
+        return luaL_error( L, "string slice too long" );
+    }
     for(; head < tail; head++ ){
         lua_pushinteger( L, ((unsigned char*)b->mem)[head] );
     }
@@ -242,101 +758,550 @@ static int total_lua( lua_State *L )
 }
 
 
-#define upperlower_lua(L,range,op) ({ \
-    int rc = 2; \
-    buf_t *b = checkudata( L ); \
-    unsigned char *lmem = pnalloc( (size_t)b->used, unsigned char ); \
-    if( lmem ) { \
-        unsigned char *ptr = (unsigned char*)b->mem; \
-        size_t i = 0; \
-        for(; i < b->used; i++ ) { \
-            switch( ptr[i] ){ \
-                case range: \
-                    lmem[i] = ptr[i] op 0x20; \
-                break; \
-                default: \
-                    lmem[i] = ptr[i]; \
-            } \
-        } \
-        lua_pushlstring( L, (const char*)lmem, (size_t)b->used ); \
-        rc = 1; \
-    } \
-    else { \
-        lua_pushnil( L ); \
-        lua_pushstring( L, strerror(errno) ); \
-    } \
-    rc; \
-})
+// parallel job of the worker pool
+typedef struct {
+    const unsigned char *src;
+    unsigned char *dest;
+    size_t len;
+    size_t chunk;
+    const unsigned char *tbl;
+    int algo;
+    uint32_t *sums;
+} bufjob_t;
 
-// A-Z + 0x20
-static int lower_lua( lua_State *L )
-{
-    return upperlower_lua( L, 'A' ... 'Z', + );
-}
 
-// a-z - 0x20
-static int upper_lua( lua_State *L )
+// returns the offset of the chunk idx and set its length to n
+static inline size_t bufjob_range( bufjob_t *job, size_t idx, size_t *n )
 {
-    return upperlower_lua( L, 'a' ... 'z', - );
+    size_t off = idx * job->chunk;
+    
+    *n = ( job->len - off < job->chunk ) ? job->len - off : job->chunk;
+    
+    return off;
 }
 
 
-static int hex_lua( lua_State *L )
+static inline void bufcase( unsigned char *dest, const unsigned char *src, 
+                            size_t len, unsigned char lo, unsigned char hi )
 {
-    buf_t *b = checkudata( L );
-    size_t len = b->used * 2;
-    char *enc = malloc( len );
+    size_t i = 0;
     
-    if( enc ){
-        hex_encode( (unsigned char*)enc, (unsigned char*)b->mem, b->used );
-        lua_pushlstring( L, enc, len );
-        return 1;
+    // flip the case bit of the letters in the range of lo-hi
+    for(; i < len; i++ ){
+        dest[i] = src[i] ^ ( (unsigned char)( src[i] - lo ) <= 
+                             (unsigned char)( hi - lo ) ? 0x20 : 0 );
     }
+}
+
+
+static void bufjob_lower( void *arg, size_t idx )
+{
+    bufjob_t *job = (bufjob_t*)arg;
+    size_t n = 0;
+    size_t off = bufjob_range( job, idx, &n );
     
-    // nomem error
-    lua_pushnil( L );
-    lua_pushstring( L, strerror( errno ) );
-    
-    return 2;
+    bufcase( job->dest + off, job->src + off, n, 'A', 'Z' );
 }
 
 
-#define base64_lua( L, fn ) ({ \
-    buf_t *b = checkudata( L ); \
-    size_t len = b->used; \
-    char *enc = fn( (unsigned char*)b->mem, &len ); \
-    int rc = 1; \
-    if( !enc ){ \
-        lua_pushnil( L ); \
-        lua_pushstring( L, strerror( errno ) ); \
-        rc = 2; \
-    } \
-    lua_pushlstring( L, enc, len ); \
-    rc; \
-})
+static void bufjob_upper( void *arg, size_t idx )
+{
+    bufjob_t *job = (bufjob_t*)arg;
+    size_t n = 0;
+    size_t off = bufjob_range( job, idx, &n );
+    
+    bufcase( job->dest + off, job->src + off, n, 'a', 'z' );
+}
 
-// base64 standard encoding
-static int base64std_lua( lua_State *L )
+
+static void bufjob_hex( void *arg, size_t idx )
 {
-    return base64_lua( L, b64m_encode_std );
+    bufjob_t *job = (bufjob_t*)arg;
+    size_t n = 0;
+    size_t off = bufjob_range( job, idx, &n );
+    
+    hex_encode( job->dest + off * 2, (unsigned char*)job->src + off, n );
 }
 
-// base64 url encoding
-static int base64url_lua( lua_State *L )
+
+// chunks are aligned to 3 bytes, so only the last chunk is padded
+static void bufjob_base64( void *arg, size_t idx )
 {
-    return base64_lua( L, b64m_encode_url );
+    bufjob_t *job = (bufjob_t*)arg;
+    size_t n = 0;
+    size_t off = bufjob_range( job, idx, &n );
+    
+    b64m_encode_to( job->dest + off / 3 * 4, job->src + off, n, job->tbl );
 }
 
 
-static inline int buf_set( buf_t *b, size_t pos, const char *str, size_t len )
+// encode the contents of b by fn into the allocated memory of len bytes,
+// then push it as a string. the string is cached as kind.
+static inline int bufjob_encode( lua_State *L, buf_t *b, wpool_fn fn, 
+                                 size_t len, size_t align, 
+                                 const unsigned char *tbl, int kind )
 {
-    int rc = 0;
+    bufjob_t job = {
+        .src = (const unsigned char*)b->mem,
+        .len = b->used,
+        .tbl = tbl
+    };
     
-    if( len > 0 )
-    {
-        rc = buf_increase( b, pos, len + 1 );
-        if( rc == 0 ){
-            memcpy( b->mem + pos, str, len );
+    if( buf_cached( L, b, kind ) ){
+        return 1;
+    }
+    else if( !( job.dest = pnalloc( len + 1, unsigned char ) ) ){
+        lua_pushnil( L );
+        lua_pushstring( L, strerror( errno ) );
+        return 2;
+    }
+    
+    wpool_run( fn, &job, wpool_split( job.len, align, &job.chunk ) );
+    lua_pushlstring( L, (const char*)job.dest, len );
+    pdealloc( job.dest );
+    buf_cache( L, b, kind );
+    
+    return 1;
+}
+
+
+// A-Z + 0x20
+static int lower_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    
+    return bufjob_encode( L, b, bufjob_lower, b->used, 1, NULL, 
+                          BUF_CACHE_NONE );
+}
+
+// a-z - 0x20
+static int upper_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    
+    return bufjob_encode( L, b, bufjob_upper, b->used, 1, NULL, 
+                          BUF_CACHE_NONE );
+}
+
+
+static int hex_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    
+    return bufjob_encode( L, b, bufjob_hex, b->used * 2, 1, NULL, 
+                          BUF_CACHE_HEX );
+}
+
+
+static inline int base64_lua( lua_State *L, const unsigned char *tbl )
+{
+    buf_t *b = checkudata( L );
+    size_t len = b->used / 3 * 4;
+    
+    // tail bytes
+    if( b->used % 3 ){
+        len += ( tbl == BASE64MIX_STDENC ) ? 4 : b->used % 3 + 1;
+    }
+    
+    return bufjob_encode( L, b, bufjob_base64, len, 3, tbl, 
+                          ( tbl == BASE64MIX_STDENC ) ? BUF_CACHE_BASE64 : 
+                                                        BUF_CACHE_BASE64URL );
+}
+
+// base64 standard encoding
+static int base64std_lua( lua_State *L )
+{
+    return base64_lua( L, BASE64MIX_STDENC );
+}
+
+// base64 url encoding
+static int base64url_lua( lua_State *L )
+{
+    return base64_lua( L, BASE64MIX_URLENC );
+}
+
+
+static inline buf_t *checkbufudata( lua_State *L, int idx )
+{
+    buf_t *b = (buf_t*)luaL_checkudata( L, idx, MODULE_MT );
+    
+    if( !b->mem ){
+        luaL_argerror( L, idx, "attempted to access already freed memory" );
+    }
+    
+    return b;
+}
+
+
+// arg#idx: destination buffer. returns the b if omitted
+static inline buf_t *optdstudata( lua_State *L, int idx, buf_t *b )
+{
+    if( !lua_isnoneornil( L, idx ) ){
+        return checkbufudata( L, idx );
+    }
+    
+    return b;
+}
+
+
+// encode/escape into the tail of dst, or replace the contents of b if 
+// dst is b.
+#define escape_lua( L, lenfn, encfn, ... ) ({ \
+    buf_t *b = checkudata( L ); \
+    buf_t *dst = optdstudata( L, 2, b ); \
+    size_t len = lenfn( (unsigned char*)b->mem, b->used, ##__VA_ARGS__ ); \
+    size_t pos = ( dst == b ) ? 0 : dst->used; \
+    int rc = 0; \
+    if( len < b->used ){ \
+        errno = ERANGE; \
+        lua_pushstring( L, strerror( errno ) ); \
+        rc = 1; \
+    } \
+    else if( buf_writable( dst, pos ) != 0 || \
+             buf_increase( dst, pos, len + 1 ) != 0 ){ \
+        lua_pushstring( L, strerror( errno ) ); \
+        rc = 1; \
+    } \
+    else { \
+        encfn( (unsigned char*)dst->mem + pos, len, (unsigned char*)b->mem, \
+               b->used, ##__VA_ARGS__ ); \
+        if( dst == b ){ \
+            b->cur = 0; \
+            buf_touch( b, 0 ); \
+        } \
+        buf_term( dst, pos + len ); \
+    } \
+    rc; \
+})
+
+// percent-encoding of RFC 3986
+static int urlencode_lua( lua_State *L )
+{
+    return escape_lua( L, urlenc_len, urlenc, 0 );
+}
+
+// application/x-www-form-urlencoded encoding
+static int urlencodeform_lua( lua_State *L )
+{
+    return escape_lua( L, urlenc_len, urlenc, 1 );
+}
+
+// html escaping
+static int htmlescape_lua( lua_State *L )
+{
+    return escape_lua( L, htmlesc_len, htmlesc );
+}
+
+
+static inline int urldecode( lua_State *L, int form )
+{
+    buf_t *b = checkudata( L );
+    buf_t *dst = optdstudata( L, 2, b );
+    ssize_t len = 0;
+    
+    // decode in place
+    if( dst == b )
+    {
+        if( buf_writable( b, 0 ) != 0 ){
+            lua_pushstring( L, strerror( errno ) );
+            return 1;
+        }
+        // verify before overwriting the contents
+        if( urldec_verify( (unsigned char*)b->mem, b->used ) == 0 ){
+            len = urldec( (unsigned char*)b->mem, (unsigned char*)b->mem, 
+                          b->used, form );
+            b->cur = 0;
+            buf_touch( b, 0 );
+            buf_term( b, (size_t)len );
+            return 0;
+        }
+    }
+    else if( buf_increase( dst, dst->used, b->used + 1 ) == 0 )
+    {
+        len = urldec( (unsigned char*)dst->mem + dst->used, 
+                      (unsigned char*)b->mem, b->used, form );
+        if( len != -1 ){
+            buf_term( dst, dst->used + (size_t)len );
+            return 0;
+        }
+        // restore the null-term
+        buf_term( dst, dst->used );
+    }
+    
+    // got error
+    lua_pushstring( L, strerror( errno ) );
+    
+    return 1;
+}
+
+static int urldecode_lua( lua_State *L )
+{
+    return urldecode( L, 0 );
+}
+
+static int urldecodeform_lua( lua_State *L )
+{
+    return urldecode( L, 1 );
+}
+
+
+// arg#idx, idx+1: range of contents as string.sub.
+// returns 0 if the range is empty.
+static inline int checkrange( lua_State *L, int idx, buf_t *b, size_t *head, 
+                              size_t *tail )
+{
+    lua_Integer used = (lua_Integer)b->used;
+    lua_Integer lhead = luaL_optinteger( L, idx, 1 );
+    lua_Integer ltail = luaL_optinteger( L, idx + 1, -1 );
+    
+    if( lhead < 0 ){
+        lhead = ( lhead + used < 0 ) ? 1 : lhead + used + 1;
+    }
+    else if( lhead == 0 ){
+        lhead = 1;
+    }
+    if( ltail < 0 ){
+        ltail += used + 1;
+    }
+    else if( ltail > used ){
+        ltail = used;
+    }
+    
+    if( lhead > ltail ){
+        *head = *tail = 0;
+        return 0;
+    }
+    *head = (size_t)lhead - 1;
+    *tail = (size_t)ltail;
+    
+    return 1;
+}
+
+
+static int isutf8_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    size_t head = 0;
+    size_t tail = 0;
+    size_t pos = 0;
+    
+    if( checkrange( L, 2, b, &head, &tail ) ){
+        pos = head + utf8_validate( (unsigned char*)b->mem + head, 
+                                    tail - head );
+    }
+    if( pos == tail ){
+        lua_pushboolean( L, 1 );
+        return 1;
+    }
+    
+    // position of the invalid byte
+    lua_pushboolean( L, 0 );
+    lua_pushinteger( L, (lua_Integer)pos + 1 );
+    
+    return 2;
+}
+
+
+static int isutf8stream_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    int final = lua_toboolean( L, 2 );
+    unsigned char *mem = (unsigned char*)b->mem + b->u8pos;
+    size_t len = b->used - b->u8pos;
+    size_t pos = 0;
+    
+    if( b->u8pos > b->used ){
+        b->u8pos = 0;
+        mem = (unsigned char*)b->mem;
+        len = b->used;
+    }
+    // the trailing incomplete sequence will be validated at the next call
+    if( !final ){
+        len = utf8_boundary( mem, len );
+    }
+    pos = utf8_validate( mem, len );
+    b->u8pos += pos;
+    if( pos == len ){
+        lua_pushboolean( L, 1 );
+        return 1;
+    }
+    
+    // position of the invalid byte
+    lua_pushboolean( L, 0 );
+    lua_pushinteger( L, (lua_Integer)b->u8pos + 1 );
+    
+    return 2;
+}
+
+
+static int utf8len_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    size_t head = 0;
+    size_t tail = 0;
+    size_t pos = 0;
+    
+    if( checkrange( L, 2, b, &head, &tail ) ){
+        pos = head + utf8_validate( (unsigned char*)b->mem + head, 
+                                    tail - head );
+    }
+    if( pos == tail ){
+        lua_pushinteger( L, (lua_Integer)utf8_count( 
+            (unsigned char*)b->mem + head, tail - head 
+        ) );
+        return 1;
+    }
+    
+    // position of the invalid byte
+    lua_pushnil( L );
+    lua_pushinteger( L, (lua_Integer)pos + 1 );
+    
+    return 2;
+}
+
+
+static inline uint32_t bufsum_update( int algo, uint32_t sum, 
+                                      const unsigned char *src, size_t len )
+{
+    switch( algo ){
+        case BUF_SUM_CRC32C:
+            return crc32c_update( sum, src, len );
+        case BUF_SUM_CRC32:
+            return crc32_update( sum, src, len );
+        default:
+            return adler32_update( sum, src, len );
+    }
+}
+
+
+static void bufjob_checksum( void *arg, size_t idx )
+{
+    bufjob_t *job = (bufjob_t*)arg;
+    size_t n = 0;
+    size_t off = bufjob_range( job, idx, &n );
+    // the first chunk is calculated from the seed, and the others are
+    // calculated from the initial value
+    uint32_t sum = idx ? ( job->algo == BUF_SUM_ADLER32 ) : job->sums[0];
+    
+    job->sums[idx] = bufsum_update( job->algo, sum, job->src + off, n );
+}
+
+
+// calculate the checksum of the chunks in parallel and concatenate them
+static inline uint32_t bufsum( int algo, uint32_t sum, 
+                               const unsigned char *src, size_t len )
+{
+    bufjob_t job = {
+        .src = src,
+        .len = len,
+        .algo = algo
+    };
+    size_t nchunk = wpool_split( len, 1, &job.chunk );
+    size_t i = 1;
+    
+    if( nchunk < 2 || !( job.sums = pnalloc( nchunk, uint32_t ) ) ){
+        return bufsum_update( algo, sum, src, len );
+    }
+    
+    job.sums[0] = sum;
+    wpool_run( bufjob_checksum, &job, nchunk );
+    sum = job.sums[0];
+    for(; i < nchunk; i++ )
+    {
+        size_t n = 0;
+        
+        bufjob_range( &job, i, &n );
+        switch( algo ){
+            case BUF_SUM_CRC32C:
+                sum = crc32c_concat( sum, job.sums[i], n );
+            break;
+            case BUF_SUM_CRC32:
+                sum = crc32_concat( sum, job.sums[i], n );
+            break;
+            default:
+                sum = adler32_concat( sum, job.sums[i], n );
+        }
+    }
+    pdealloc( job.sums );
+    
+    return sum;
+}
+
+
+#define checksum_lua( L, algo, init ) ({ \
+    buf_t *b = checkudata( L ); \
+    size_t head = 0; \
+    size_t tail = 0; \
+    uint32_t sum = (uint32_t)luaL_optinteger( L, 4, init ); \
+    if( checkrange( L, 2, b, &head, &tail ) ){ \
+        sum = bufsum( algo, sum, (unsigned char*)b->mem + head, \
+                      tail - head ); \
+    } \
+    lua_pushinteger( L, (lua_Integer)sum ); \
+    1; \
+})
+
+static int crc32c_lua( lua_State *L )
+{
+    return checksum_lua( L, BUF_SUM_CRC32C, 0 );
+}
+
+static int crc32_lua( lua_State *L )
+{
+    return checksum_lua( L, BUF_SUM_CRC32, 0 );
+}
+
+static int adler32_lua( lua_State *L )
+{
+    return checksum_lua( L, BUF_SUM_ADLER32, 1 );
+}
+
+
+// checksum of the whole contents that calculated incrementally
+#define checksumstream_lua( L, algo, init ) ({ \
+    buf_t *b = checkudata( L ); \
+    if( b->sumalgo != algo || b->sumpos > b->used ){ \
+        b->sumalgo = algo; \
+        b->sumpos = 0; \
+        b->sumval = init; \
+    } \
+    b->sumval = bufsum( algo, b->sumval, \
+                        (unsigned char*)b->mem + b->sumpos, \
+                        b->used - b->sumpos ); \
+    b->sumpos = b->used; \
+    lua_pushinteger( L, (lua_Integer)b->sumval ); \
+    1; \
+})
+
+static int crc32cstream_lua( lua_State *L )
+{
+    return checksumstream_lua( L, BUF_SUM_CRC32C, 0 );
+}
+
+static int crc32stream_lua( lua_State *L )
+{
+    return checksumstream_lua( L, BUF_SUM_CRC32, 0 );
+}
+
+static int adler32stream_lua( lua_State *L )
+{
+    return checksumstream_lua( L, BUF_SUM_ADLER32, 1 );
+}
+
+
+static inline int buf_set( buf_t *b, size_t pos, const char *str, size_t len )
+{
+    int rc = 0;
+    
+    if( buf_writable( b, pos ) != 0 ){
+        return -1;
+    }
+    buf_touch( b, pos );
+    if( len > 0 )
+    {
+        rc = buf_increase( b, pos, len + 1 );
+        if( rc == 0 ){
+            memcpy( b->mem + pos, str, len );
             buf_term( b, pos + len );
         }
     }
@@ -356,6 +1321,7 @@ static int set_lua( lua_State *L )
     
     if( buf_set( b, 0, str, len ) == 0 ){
         b->cur = 0;
+        buf_uncache_stale( L, b );
         return 0;
     }
     
@@ -385,6 +1351,13 @@ static int add_lua( lua_State *L )
         }
     }
     
+    // above the high watermark
+    if( b->wmhigh ){
+        lua_pushnil( L );
+        lua_pushboolean( L, b->wmabove );
+        return 2;
+    }
+    
     return 0;
 }
 
@@ -414,7 +1387,10 @@ static int insert_lua( lua_State *L )
         }
     }
     
-    if( buf_increase( b, b->used, len + 1 ) == 0 ){
+    if( buf_writable( b, (size_t)idx ) == 0 && 
+        buf_increase( b, b->used, len + 1 ) == 0 ){
+        buf_touch( b, (size_t)idx );
+        buf_stat( b, moved, b->used - (size_t)idx );
         memmove( b->mem + (size_t)idx + len, b->mem + (size_t)idx, 
                  b->used - (size_t)idx + 1 );
         memcpy( b->mem + idx, str, len );
@@ -429,33 +1405,236 @@ static int insert_lua( lua_State *L )
 }
 
 
-static int sub_lua( lua_State *L )
+// an edit that replaces the range of head-tail with str
+typedef struct {
+    size_t head;
+    size_t tail;
+    const char *str;
+    size_t len;
+} bufedit_t;
+
+
+// resolve the range of i-j like string.sub, but keep the position of the
+// empty range for insertion
+static inline void bufedit_range( buf_t *b, lua_Integer lhead, 
+                                  lua_Integer ltail, bufedit_t *edit )
 {
-    buf_t *b = checkudata( L );
-    lua_Integer lhead = luaL_checkinteger( L, 2 );
-    size_t head = 0;
-    size_t tail = b->used;
+    lua_Integer used = (lua_Integer)b->used;
     
-    // check arguments
-    // head
-    if( lhead >= (lua_Integer)b->used ){
-        goto EMPTY_STRING;
+    if( lhead < 0 ){
+        lhead = ( lhead + used < 0 ) ? 1 : lhead + used + 1;
     }
-    else if( lhead > 0 ){
-        head = (size_t)lhead - 1;
+    else if( lhead == 0 ){
+        lhead = 1;
     }
-    else if( lhead < 0 && ( lhead + (lua_Integer)b->used ) > 0 ){
-        head = (size_t)( lhead + (lua_Integer)b->used );
+    else if( lhead > used + 1 ){
+        lhead = used + 1;
     }
-    // tail
-    if( !lua_isnoneornil( L, 3 ) )
-    {
-        lua_Integer ltail = luaL_checkinteger( L, 3 );
-        
-        if( ltail < 0 )
-        {
-            if( ( ltail + (lua_Integer)b->used ) > 0 ){
-                tail = (size_t)( ltail + (lua_Integer)b->used + 1 );
+    if( ltail < 0 ){
+        ltail += used + 1;
+    }
+    else if( ltail > used ){
+        ltail = used;
+    }
+    
+    edit->head = (size_t)lhead - 1;
+    edit->tail = ( ltail < lhead ) ? edit->head : (size_t)ltail;
+}
+
+
+// apply the sorted and non-overlapping edits. every byte after the first 
+// edit is moved at most once.
+static inline int buf_splice( buf_t *b, bufedit_t *edits, size_t nedit )
+{
+    size_t used = b->used;
+    size_t i = 0;
+    
+    if( !nedit ){
+        return 0;
+    }
+    
+    // calculate the new length
+    for(; i < nedit; i++ )
+    {
+        size_t removed = edits[i].tail - edits[i].head;
+        
+        if( edits[i].len > removed && 
+            SIZE_MAX - used - 1 < edits[i].len - removed ){
+            errno = ENOMEM;
+            return -1;
+        }
+        used = used + edits[i].len - removed;
+    }
+    if( buf_writable( b, edits[0].head ) != 0 || 
+        buf_increase( b, 0, used + 1 ) != 0 ){
+        return -1;
+    }
+    buf_touch( b, edits[0].head );
+    
+    // the segments shifted to the head are moved in ascending order, and
+    // the segments shifted to the tail are moved in descending order.
+    // the segment of i is between the edit of i-1 and the edit of i.
+    {
+        char *mem = (char*)b->mem;
+        ptrdiff_t shift = 0;
+        
+        for( i = 1; i <= nedit; i++ )
+        {
+            size_t src = edits[i - 1].tail;
+            size_t len = ( i < nedit ? edits[i].head : b->used ) - src;
+            
+            shift += (ptrdiff_t)edits[i - 1].len - 
+                     (ptrdiff_t)( edits[i - 1].tail - edits[i - 1].head );
+            if( shift < 0 && len ){
+                memmove( mem + src + shift, mem + src, len );
+                buf_stat( b, moved, len );
+            }
+        }
+        for( i = nedit; i > 0; i-- )
+        {
+            size_t src = edits[i - 1].tail;
+            size_t len = ( i < nedit ? edits[i].head : b->used ) - src;
+            
+            if( shift > 0 && len ){
+                memmove( mem + src + shift, mem + src, len );
+                buf_stat( b, moved, len );
+            }
+            shift -= (ptrdiff_t)edits[i - 1].len - 
+                     (ptrdiff_t)( edits[i - 1].tail - edits[i - 1].head );
+        }
+        // copy the strings
+        for( i = 0; i < nedit; i++ ){
+            if( edits[i].len ){
+                memcpy( mem + edits[i].head + shift, edits[i].str, 
+                        edits[i].len );
+            }
+            shift += (ptrdiff_t)edits[i].len - 
+                     (ptrdiff_t)( edits[i].tail - edits[i].head );
+        }
+    }
+    buf_term( b, used );
+    
+    return 0;
+}
+
+
+static int erase_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    bufedit_t edit = { 0, 0, NULL, 0 };
+    
+    if( checkrange( L, 2, b, &edit.head, &edit.tail ) && 
+        buf_splice( b, &edit, 1 ) != 0 ){
+        // got error
+        lua_pushstring( L, strerror( errno ) );
+        return 1;
+    }
+    
+    return 0;
+}
+
+
+static int replace_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    lua_Integer lhead = luaL_checkinteger( L, 2 );
+    lua_Integer ltail = luaL_checkinteger( L, 3 );
+    bufedit_t edit;
+    
+    edit.str = luaL_checklstring( L, 4, &edit.len );
+    bufedit_range( b, lhead, ltail, &edit );
+    if( buf_splice( b, &edit, 1 ) != 0 ){
+        // got error
+        lua_pushstring( L, strerror( errno ) );
+        return 1;
+    }
+    
+    return 0;
+}
+
+
+static int splice_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    size_t nedit = 0;
+    bufedit_t *edits = NULL;
+    size_t i = 0;
+    int rc = 0;
+    
+    luaL_checktype( L, 2, LUA_TTABLE );
+    if( !( nedit = lua_objlen( L, 2 ) ) ){
+        return 0;
+    }
+    else if( !( edits = pnalloc( nedit, bufedit_t ) ) ){
+        lua_pushstring( L, strerror( errno ) );
+        return 1;
+    }
+    
+    for(; i < nedit; i++ )
+    {
+        lua_rawgeti( L, 2, (int)i + 1 );
+        if( lua_type( L, -1 ) != LUA_TTABLE ){
+            pdealloc( edits );
+            return luaL_argerror( L, 2, "edit must be table" );
+        }
+        lua_rawgeti( L, -1, 1 );
+        lua_rawgeti( L, -2, 2 );
+        lua_rawgeti( L, -3, 3 );
+        if( !lua_isnumber( L, -3 ) || !lua_isnumber( L, -2 ) || 
+            !( lua_isnil( L, -1 ) || lua_type( L, -1 ) == LUA_TSTRING ) ){
+            pdealloc( edits );
+            return luaL_argerror( L, 2, "edit must be { i, j [, str] }" );
+        }
+        bufedit_range( b, lua_tointeger( L, -3 ), lua_tointeger( L, -2 ), 
+                       edits + i );
+        // the strings are referenced from the table of arg#2
+        edits[i].str = lua_tolstring( L, -1, &edits[i].len );
+        lua_pop( L, 4 );
+        if( i && edits[i].head < edits[i - 1].tail ){
+            pdealloc( edits );
+            return luaL_argerror( L, 2, 
+                                  "edits must be sorted and not overlapped" );
+        }
+    }
+    
+    if( buf_splice( b, edits, nedit ) != 0 ){
+        // got error
+        lua_pushstring( L, strerror( errno ) );
+        rc = 1;
+    }
+    pdealloc( edits );
+    
+    return rc;
+}
+
+
+static int sub_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    lua_Integer lhead = luaL_checkinteger( L, 2 );
+    size_t head = 0;
+    size_t tail = b->used;
+    
+    // check arguments
+    // head
+    if( lhead > (lua_Integer)b->used ){
+        goto EMPTY_STRING;
+    }
+    else if( lhead > 0 ){
+        head = (size_t)lhead - 1;
+    }
+    else if( lhead < 0 && ( lhead + (lua_Integer)b->used ) > 0 ){
+        head = (size_t)( lhead + (lua_Integer)b->used );
+    }
+    // tail
+    if( !lua_isnoneornil( L, 3 ) )
+    {
+        lua_Integer ltail = luaL_checkinteger( L, 3 );
+        
+        if( ltail < 0 )
+        {
+            if( ( ltail + (lua_Integer)b->used ) > 0 ){
+                tail = (size_t)( ltail + (lua_Integer)b->used + 1 );
             }
         }
         else if( ltail <= (lua_Integer)b->used ){
@@ -467,6 +1646,7 @@ static int sub_lua( lua_State *L )
         }
     }
     
+    buf_stat( b, copied, tail - head );
     lua_pushlstring( L, b->mem + head, tail - head );
     return 1;
     
@@ -507,6 +1687,7 @@ static int substr_lua( lua_State *L )
         }
     }
     
+    buf_stat( b, copied, tail - head );
     lua_pushlstring( L, b->mem + head, (size_t)(tail - head) );
     return 1;
     
@@ -517,227 +1698,3320 @@ EMPTY_STRING:
 }
 
 
-static int setfd_lua( lua_State *L )
+// tokenizers. the iterators keep the buffer, the delimiter and the next
+// position in the upvalues, and yield the positions of the tokens.
+#define checkiterbuf(L) ({ \
+    buf_t *_b = (buf_t*)lua_touserdata( L, lua_upvalueindex( 1 ) ); \
+    if( !_b->mem ){ \
+        return luaL_error( L, "attempted to access already freed memory" ); \
+    } \
+    _b; \
+})
+
+
+static int split_next_lua( lua_State *L )
+{
+    buf_t *b = checkiterbuf( L );
+    size_t dlen = 0;
+    const char *delim = lua_tolstring( L, lua_upvalueindex( 2 ), &dlen );
+    lua_Integer pos = lua_tointeger( L, lua_upvalueindex( 3 ) );
+    size_t head = (size_t)pos;
+    size_t len = 0;
+    
+    // finished or truncated
+    if( pos < 0 || head > b->used ){
+        return 0;
+    }
+    
+    len = bscan_find( (unsigned char*)b->mem + head, b->used - head, 
+                      (const unsigned char*)delim, dlen );
+    if( head + len < b->used ){
+        lua_pushinteger( L, (lua_Integer)( head + len + dlen ) );
+    }
+    else {
+        lua_pushinteger( L, -1 );
+    }
+    lua_replace( L, lua_upvalueindex( 3 ) );
+    lua_pushinteger( L, (lua_Integer)head + 1 );
+    lua_pushinteger( L, (lua_Integer)( head + len ) );
+    
+    return 2;
+}
+
+
+static int split_lua( lua_State *L )
+{
+    size_t len = 0;
+    
+    checkudata( L );
+    // check arguments
+    // delimiter
+    luaL_checklstring( L, 2, &len );
+    if( !len ){
+        return luaL_argerror( L, 2, "delimiter must not be empty" );
+    }
+    
+    lua_settop( L, 2 );
+    lua_pushinteger( L, 0 );
+    lua_pushcclosure( L, split_next_lua, 3 );
+    
+    return 1;
+}
+
+
+static int tokens_next_lua( lua_State *L )
+{
+    buf_t *b = checkiterbuf( L );
+    const bscan_t *bs = (const bscan_t*)lua_touserdata( L, 
+                                                lua_upvalueindex( 2 ) );
+    size_t head = (size_t)lua_tointeger( L, lua_upvalueindex( 3 ) );
+    const unsigned char *mem = (const unsigned char*)b->mem;
+    size_t len = 0;
+    
+    // skip the separators
+    if( head >= b->used || 
+        ( head += bscan_span( bs, mem + head, b->used - head, 0 ) ) == 
+        b->used ){
+        return 0;
+    }
+    
+    len = bscan_span( bs, mem + head, b->used - head, 1 );
+    lua_pushinteger( L, (lua_Integer)( head + len ) );
+    lua_replace( L, lua_upvalueindex( 3 ) );
+    lua_pushinteger( L, (lua_Integer)head + 1 );
+    lua_pushinteger( L, (lua_Integer)( head + len ) );
+    
+    return 2;
+}
+
+
+static int tokens_lua( lua_State *L )
+{
+    size_t len = 0;
+    const char *set = NULL;
+    bscan_t *bs = NULL;
+    
+    checkudata( L );
+    // check arguments
+    // separators
+    set = luaL_checklstring( L, 2, &len );
+    if( !len ){
+        return luaL_argerror( L, 2, "separators must not be empty" );
+    }
+    
+    lua_settop( L, 1 );
+    bs = lua_newuserdata( L, sizeof( bscan_t ) );
+    bscan_init( bs, (const unsigned char*)set, len );
+    lua_pushinteger( L, 0 );
+    lua_pushcclosure( L, tokens_next_lua, 3 );
+    
+    return 1;
+}
+
+
+static int count_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    size_t dlen = 0;
+    const char *delim = luaL_checklstring( L, 2, &dlen );
+    
+    if( !dlen ){
+        return luaL_argerror( L, 2, "delimiter must not be empty" );
+    }
+    lua_pushinteger( L, (lua_Integer)bscan_count( (unsigned char*)b->mem, 
+                                                  b->used, 
+                                                  (const unsigned char*)delim,
+                                                  dlen ) );
+    
+    return 1;
+}
+
+
+static int parsehttp_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    const unsigned char *mem = (const unsigned char*)b->mem;
+    size_t len = 0;
+    size_t pos = 0;
+    httph_line_t line;
+    httph_field_t field;
+    lua_Integer idx = 0;
+    int rc = 0;
+    
+    // check arguments
+    // arg#2 result table
+    luaL_checktype( L, 2, LUA_TTABLE );
+    lua_settop( L, 2 );
+    
+    // the head is incomplete. the next call resumes from the tail
+    if( !( len = httph_complete( mem, b->used, b->httppos ) ) ){
+        b->httppos = b->used;
+        lua_pushnil( L );
+        lua_pushnil( L );
+        lua_pushboolean( L, 1 );
+        return 3;
+    }
+    b->httppos = 0;
+    
+    if( !( pos = httph_parseline( mem, len, &line ) ) ){
+        lua_pushnil( L );
+        lua_pushstring( L, "malformed start-line" );
+        return 2;
+    }
+    else if( line.status )
+    {
+        lua_pushnil( L );
+        lua_setfield( L, 2, "method" );
+        lua_pushnil( L );
+        lua_setfield( L, 2, "path" );
+        lua_pushinteger( L, line.status );
+        lua_setfield( L, 2, "status" );
+        lua_pushlstring( L, (const char*)mem + line.reason, line.rlen );
+        lua_setfield( L, 2, "reason" );
+    }
+    else
+    {
+        lua_pushlstring( L, (const char*)mem + line.method, line.mlen );
+        lua_setfield( L, 2, "method" );
+        lua_pushlstring( L, (const char*)mem + line.target, line.tlen );
+        lua_setfield( L, 2, "path" );
+        lua_pushnil( L );
+        lua_setfield( L, 2, "status" );
+        lua_pushnil( L );
+        lua_setfield( L, 2, "reason" );
+    }
+    lua_pushnumber( L, 1 + line.minor / 10.0 );
+    lua_setfield( L, 2, "version" );
+    
+    // reuse the headers table
+    lua_getfield( L, 2, "headers" );
+    if( !lua_istable( L, -1 ) ){
+        lua_pop( L, 1 );
+        lua_newtable( L );
+        lua_pushvalue( L, -1 );
+        lua_setfield( L, 2, "headers" );
+    }
+    // positions of the name and the value of each field
+    while( ( rc = httph_parsefield( mem, len, &pos, &field ) ) == 1 )
+    {
+        lua_pushinteger( L, (lua_Integer)field.name + 1 );
+        lua_rawseti( L, -2, (int)++idx );
+        lua_pushinteger( L, (lua_Integer)( field.name + field.nlen ) );
+        lua_rawseti( L, -2, (int)++idx );
+        lua_pushinteger( L, (lua_Integer)field.value + 1 );
+        lua_rawseti( L, -2, (int)++idx );
+        lua_pushinteger( L, (lua_Integer)( field.value + field.vlen ) );
+        lua_rawseti( L, -2, (int)++idx );
+    }
+    if( rc == -1 ){
+        lua_pushnil( L );
+        lua_pushstring( L, "malformed header field" );
+        return 2;
+    }
+    // discard the fields of the previous head
+    for( rc = (int)lua_objlen( L, -1 ); rc > idx; rc-- ){
+        lua_pushnil( L );
+        lua_rawseti( L, -2, rc );
+    }
+    lua_pushinteger( L, idx / 4 );
+    lua_setfield( L, 2, "nheader" );
+    
+    lua_pushinteger( L, (lua_Integer)len );
+    
+    return 1;
+}
+
+
+static int setfd_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    int fd = luaL_checkint( L, 2 );
+    
+    // check arguments
+    if( fd < 0 ){
+        return luaL_argerror( L, 2, "fd must be larger than 0" );
+    }
+    // cloexec
+    else if( lua_gettop( L ) > 2 ){
+        luaL_checktype( L, 3, LUA_TBOOLEAN );
+        b->cloexec = lua_toboolean( L, 3 );
+    }
+    b->fd = fd;
+    
+    if( b->direct && dio_setfd( fd, 1 ) != 0 ){
+        lua_pushstring( L, strerror( errno ) );
+        return 1;
+    }
+    
+    return 0;
+}
+
+
+static int cloexec_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    
+    if( lua_gettop( L ) > 1 ){
+        luaL_checktype( L, 2, LUA_TBOOLEAN );
+        b->cloexec = lua_toboolean( L, 2 );
+    }
+    
+    lua_pushboolean( L, b->cloexec );
+    
+    return 1;
+}
+
+
+static inline int read2buf( lua_State *L, buf_t *b, size_t pos )
+{
+    size_t bytes = b->unit;
+    ssize_t len = 0;
+    lua_Integer rbytes = luaL_optinteger( L, 2, 0 );
+
+    // check arguments
+    // arg#2 bytes
+    if( rbytes < 0 ){
+        return luaL_argerror( L, 2, "bytes must be larger than 0" );
+    }
+    else if( rbytes ){
+        bytes = (size_t)rbytes;
+    }
+    
+    len = buf_read( b, pos, bytes );
+    // set number of bytes read
+    lua_pushinteger( L, (lua_Integer)len );
+    // got error
+    if( len == -1 ){
+        lua_pushstring( L, strerror( errno ) );
+        lua_pushboolean( L, errno == EAGAIN || errno == EWOULDBLOCK );
+        return 3;
+    }
+    // rewind the write cursor
+    else if( pos == 0 ){
+        b->cur = 0;
+        buf_account( b );
+    }
+    
+    return 1;
+}
+
+
+static int read_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    return read2buf( L, b, 0 );
+}
+
+
+static int readadd_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    return read2buf( L, b, b->used );
+}
+
+
+static int write_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    ssize_t len = 0;
+    struct iovec iov;
+    
+    iov.iov_base = (void*)luaL_checklstring( L, 2, &iov.iov_len );
+    // the buffer is used as the write queue if the watermarks are set
+    if( b->wmhigh )
+    {
+        // keep the order of the queued contents
+        if( b->cur < b->used ){
+            len = 0;
+        }
+        else if( ( len = buf_writev( b, b->fd, &iov ) ) == -1 &&
+                 ( errno == EAGAIN || errno == EWOULDBLOCK ) ){
+            len = 0;
+        }
+        // queue the rest
+        if( len != -1 && (size_t)len < iov.iov_len &&
+            buf_set( b, b->used, (char*)iov.iov_base + len,
+                     iov.iov_len - (size_t)len ) != 0 ){
+            len = -1;
+        }
+        
+        lua_pushinteger( L, (lua_Integer)len );
+        if( len == -1 ){
+            lua_pushstring( L, strerror( errno ) );
+        }
+        else {
+            lua_pushnil( L );
+        }
+        lua_pushboolean( L, 0 );
+        lua_pushboolean( L, b->wmabove );
+        return 4;
+    }
+    else if( iov.iov_base ){
+        len = buf_writev( b, b->fd, &iov );
+    }
+    
+    // set number of bytes read
+    lua_pushinteger( L, (lua_Integer)len );
+    if( len == -1 ){
+        lua_pushstring( L, strerror( errno ) );
+        lua_pushboolean( L, errno == EAGAIN || errno == EWOULDBLOCK );
+        return 3;
+    }
+    
+    return 1;
+}
+
+
+// send with MSG_ZEROCOPY. falls back to writev if not supported
+static inline ssize_t buf_sendzc( buf_t *b, struct iovec *iov )
+{
+    ssize_t len = 0;
+    uint64_t start = buf_probing() ? buf_clock() : 0;
+    
+    buf_usdt_entry( b, write, iov->iov_len );
+    len = zc_send( b->fd, iov->iov_base, iov->iov_len );
+    buf_usdt_return( b, write, len );
+    if( len == -1 && errno == ENOTSUP ){
+        return buf_writev( b, b->fd, iov );
+    }
+    
+    buf_stat( b, writes, 1 );
+    if( start ){
+        buf_probe( b, BUFFER_TRACE_WRITE, iov->iov_len, len, start );
+    }
+    if( len == -1 )
+    {
+        if( errno == EAGAIN || errno == EWOULDBLOCK ){
+            buf_stat( b, again, 1 );
+        }
+        return -1;
+    }
+    else if( (size_t)len < iov->iov_len ){
+        buf_stat( b, shortwrites, 1 );
+    }
+    
+    // the memory is referred by the kernel until the notification
+    if( !b->zcend ){
+        b->pinned++;
+    }
+    b->zcsent++;
+    b->zcend = (size_t)( (char*)iov->iov_base - (char*)b->mem ) + (size_t)len;
+    
+    return len;
+}
+
+
+// reap the notifications of the zero-copy sends, and release the memory if
+// all sends have been completed.
+static inline int buf_zcreap( buf_t *b )
+{
+    if( zc_reap( b->fd, &b->zcdone ) != 0 ){
+        return -1;
+    }
+    else if( b->zcdone == b->zcsent ){
+        b->zcend = 0;
+        b->pinned--;
+    }
+    
+    return 0;
+}
+
+
+static int flush_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    ssize_t len = 0;
+    struct iovec iov;
+    int zerocopy = 0;
+    
+    // check arguments
+    // arg#2 options
+    if( !lua_isnoneornil( L, 2 ) ){
+        luaL_checktype( L, 2, LUA_TTABLE );
+        lua_getfield( L, 2, "zerocopy" );
+        zerocopy = lua_toboolean( L, -1 );
+        lua_pop( L, 1 );
+    }
+    
+    if( b->cur > b->used ){
+        b->cur = 0;
+    }
+    iov.iov_base = b->mem + b->cur;
+    iov.iov_len = b->used - b->cur;
+    
+    // the asynchronous flush is in flight
+    if( b->opbusy ){
+        errno = EBUSY;
+        len = -1;
+    }
+    // release the memory of the completed zero-copy sends
+    else if( b->zcend && buf_zcreap( b ) != 0 ){
+        len = -1;
+    }
+    // nothing to send
+    else if( zerocopy && !iov.iov_len ){
+        len = 0;
+    }
+    else if( zerocopy && iov.iov_len >= ZC_MINLEN ){
+        len = buf_sendzc( b, &iov );
+    }
+    else {
+        len = buf_writev( b, b->fd, &iov );
+    }
+    
+    if( len == -1 ){
+        lua_pushinteger( L, (lua_Integer)len );
+        lua_pushinteger( L, (lua_Integer)b->used );
+        lua_pushstring( L, strerror( errno ) );
+        lua_pushboolean( L, errno == EAGAIN || errno == EWOULDBLOCK );
+        return 4;
+    }
+    else
+    {
+        b->cur += (size_t)len;
+        buf_account( b );
+        // set number of bytes write
+        lua_pushinteger( L, (lua_Integer)b->cur );
+        // set total number of bytes buffer
+        lua_pushinteger( L, (lua_Integer)b->used );
+        // the contents are referred by the kernel
+        if( b->zcend && b->cur == b->used ){
+            lua_pushnil( L );
+            lua_pushboolean( L, 1 );
+            return 4;
+        }
+        // reset buffer
+        else if( b->cur == b->used ){
+            b->cur = 0;
+            buf_touch( b, 0 );
+            buf_term( b, 0 );
+            buf_reclaim( b );
+            buf_uncache_stale( L, b );
+        }
+    }
+    
+    return 2;
+}
+
+
+// send the contents to fd through the pipes of f. returns -1 with EINVAL
+// if fd does not support splice.
+static inline ssize_t buf_fanout( buf_t *b, zc_fanout_t *f, int fd )
+{
+    ssize_t len = 0;
+    uint64_t start = buf_probing() ? buf_clock() : 0;
+    size_t nbyte = f->len;
+    
+    buf_usdt_entry( b, write, nbyte );
+    len = zc_fanout_send( f, fd );
+    buf_usdt_return( b, write, len );
+    if( len == -1 && errno == EINVAL ){
+        return -1;
+    }
+    
+    buf_stat( b, writes, 1 );
+    if( start ){
+        buf_probe( b, BUFFER_TRACE_WRITE, nbyte, len, start );
+    }
+    if( len == -1 )
+    {
+        if( errno == EAGAIN || errno == EWOULDBLOCK ){
+            buf_stat( b, again, 1 );
+        }
+    }
+    else if( (size_t)len < nbyte ){
+        buf_stat( b, shortwrites, 1 );
+    }
+    
+    return len;
+}
+
+
+static int broadcast_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    zc_fanout_t f = {
+        .src = { -1, -1 },
+        .dup = { -1, -1 },
+        .null = -1,
+        .len = 0
+    };
+    int hasoffs = 0;
+    int remain = 0;
+    int n = 0;
+    int i = 0;
+    
+    // check arguments
+    // arg#2 descriptors
+    luaL_checktype( L, 2, LUA_TTABLE );
+    n = (int)lua_objlen( L, 2 );
+    for(; i < n; i++ )
+    {
+        lua_rawgeti( L, 2, i + 1 );
+        if( !lua_isnumber( L, -1 ) || lua_tointeger( L, -1 ) < 0 ){
+            return luaL_argerror( L, 2, "descriptors must be unsigned int" );
+        }
+        lua_pop( L, 1 );
+    }
+    // arg#3 offsets
+    if( !lua_isnoneornil( L, 3 ) ){
+        luaL_checktype( L, 3, LUA_TTABLE );
+        hasoffs = 1;
+    }
+    lua_settop( L, 3 );
+    // errors
+    lua_pushnil( L );
+    
+    // copy the contents into the pipe once for all descriptors
+    if( n > 1 && b->used >= ZC_MINLEN ){
+        zc_fanout_open( &f, b->mem, b->used );
+    }
+    
+    for( i = 1; i <= n; i++ )
+    {
+        lua_Integer off = 0;
+        ssize_t len = 0;
+        struct iovec iov;
+        int fd = 0;
+        
+        lua_rawgeti( L, 2, i );
+        fd = (int)lua_tointeger( L, -1 );
+        lua_pop( L, 1 );
+        if( hasoffs ){
+            lua_rawgeti( L, 3, i );
+            off = lua_tointeger( L, -1 );
+            lua_pop( L, 1 );
+        }
+        // failed or completed
+        if( off < 0 || (size_t)off >= b->used ){
+            continue;
+        }
+        
+        iov.iov_base = b->mem + off;
+        iov.iov_len = b->used - (size_t)off;
+        if( off || !f.len ||
+            ( ( len = buf_fanout( b, &f, fd ) ) == -1 && errno == EINVAL ) ){
+            len = buf_writev( b, fd, &iov );
+        }
+        
+        if( len != -1 ){
+            off += len;
+            remain += (size_t)off < b->used;
+        }
+        else if( errno == EAGAIN || errno == EWOULDBLOCK ){
+            remain++;
+        }
+        else
+        {
+            if( lua_isnil( L, 4 ) ){
+                lua_newtable( L );
+                lua_replace( L, 4 );
+            }
+            lua_pushstring( L, strerror( errno ) );
+            lua_rawseti( L, 4, i );
+            off = -1;
+        }
+        if( hasoffs ){
+            lua_pushinteger( L, off );
+            lua_rawseti( L, 3, i );
+        }
+    }
+    zc_fanout_close( &f );
+    
+    // number of descriptors that have not received all contents
+    lua_pushinteger( L, remain );
+    lua_pushvalue( L, 4 );
+    
+    return 2;
+}
+
+
+// reserve the index for n more datagrams
+static inline int buf_msgreserve( buf_t *b, size_t n )
+{
+    if( b->msgcap - b->nmsg < n )
+    {
+        size_t cap = b->nmsg + n;
+        size_t *off = prealloc( cap, size_t, b->msgoff );
+        size_t *len = NULL;
+        unsigned char *trunc = NULL;
+        
+        if( !off ){
+            return -1;
+        }
+        b->msgoff = off;
+        if( !( len = prealloc( cap, size_t, b->msglen ) ) ){
+            return -1;
+        }
+        b->msglen = len;
+        if( !( trunc = prealloc( cap, unsigned char, b->msgtrunc ) ) ){
+            return -1;
+        }
+        b->msgtrunc = trunc;
+        b->msgcap = cap;
+    }
+    
+    return 0;
+}
+
+
+static int recvmany_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    lua_Integer lnmsg = luaL_checkinteger( L, 2 );
+    lua_Integer lsize = luaL_checkinteger( L, 3 );
+    size_t pos = b->used;
+    size_t nmsg = 0;
+    size_t size = 0;
+    int n = -1;
+    
+    // check arguments
+    // arg#2 max_msgs
+    if( lnmsg < 1 || lnmsg > DGRAM_MAXMSG ){
+        return luaL_argerror( L, 2, "max_msgs must be between 1 and 1024" );
+    }
+    // arg#3 max_size
+    else if( lsize < 1 ){
+        return luaL_argerror( L, 3, "max_size must be larger than 0" );
+    }
+    nmsg = (size_t)lnmsg;
+    size = (size_t)lsize;
+    
+    if( size > ( SIZE_MAX - 1 ) / nmsg ){
+        errno = ENOMEM;
+    }
+    else if( buf_writable( b, pos ) == 0 &&
+             buf_increase( b, pos, nmsg * size + 1 ) == 0 &&
+             buf_msgreserve( b, nmsg ) == 0 )
+    {
+        uint64_t start = buf_probing() ? buf_clock() : 0;
+        
+        buf_stat( b, reads, 1 );
+        buf_usdt_entry( b, read, nmsg * size );
+        n = dgram_recv( b->fd, b->mem + pos, size, (unsigned)nmsg,
+                        b->msglen + b->nmsg, b->msgtrunc + b->nmsg );
+        buf_usdt_return( b, read, n );
+        
+        if( n == -1 )
+        {
+            if( errno == EAGAIN || errno == EWOULDBLOCK ){
+                buf_stat( b, again, 1 );
+            }
+        }
+        else
+        {
+            int i = 0;
+            
+            for(; i < n; i++ ){
+                b->msgoff[b->nmsg] = pos;
+                pos += b->msglen[b->nmsg++];
+            }
+        }
+        if( start ){
+            buf_probe( b, BUFFER_TRACE_READ, nmsg * size,
+                       n == -1 ? -1 : (ssize_t)( pos - b->used ), start );
+        }
+        buf_term( b, pos );
+    }
+    
+    // set number of datagrams received
+    lua_pushinteger( L, (lua_Integer)n );
+    if( n == -1 ){
+        lua_pushstring( L, strerror( errno ) );
+        lua_pushboolean( L, errno == EAGAIN || errno == EWOULDBLOCK );
+        return 3;
+    }
+    
+    return 1;
+}
+
+
+static int sendmany_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    struct iovec *iov = NULL;
+    int indexed = lua_isnoneornil( L, 2 );
+    size_t nmsg = b->nmsg;
+    size_t bytes = 0;
+    size_t i = 0;
+    uint64_t start = 0;
+    int n = 0;
+    
+    // check arguments
+    // arg#2 positions
+    if( !indexed ){
+        luaL_checktype( L, 2, LUA_TTABLE );
+        nmsg = lua_objlen( L, 2 ) / 2;
+    }
+    if( nmsg > INT_MAX ){
+        return luaL_argerror( L, 2, "too many datagrams" );
+    }
+    else if( !nmsg ){
+        lua_pushinteger( L, 0 );
+        return 1;
+    }
+    else if( !( iov = pnalloc( nmsg, struct iovec ) ) ){
+        lua_pushinteger( L, -1 );
+        lua_pushstring( L, strerror( errno ) );
+        lua_pushboolean( L, 0 );
+        return 3;
+    }
+    
+    for(; i < nmsg; i++ )
+    {
+        if( indexed ){
+            iov[i].iov_base = b->mem + b->msgoff[i];
+            iov[i].iov_len = b->msglen[i];
+        }
+        else
+        {
+            lua_Integer head = 0;
+            lua_Integer tail = 0;
+            
+            lua_rawgeti( L, 2, (int)( i * 2 + 1 ) );
+            lua_rawgeti( L, 2, (int)( i * 2 + 2 ) );
+            head = lua_tointeger( L, -2 );
+            tail = lua_tointeger( L, -1 );
+            lua_pop( L, 2 );
+            if( head < 1 || tail < head - 1 || tail > (lua_Integer)b->used ){
+                pdealloc( iov );
+                return luaL_argerror( L, 2, "positions out of range" );
+            }
+            iov[i].iov_base = b->mem + head - 1;
+            iov[i].iov_len = (size_t)( tail - head + 1 );
+        }
+        bytes += iov[i].iov_len;
+    }
+    
+    start = buf_probing() ? buf_clock() : 0;
+    buf_stat( b, writes, 1 );
+    buf_usdt_entry( b, write, bytes );
+    n = dgram_send( b->fd, iov, (unsigned)nmsg );
+    buf_usdt_return( b, write, n );
+    if( start ){
+        buf_probe( b, BUFFER_TRACE_WRITE, bytes, n, start );
+    }
+    pdealloc( iov );
+    
+    // set number of datagrams sent
+    lua_pushinteger( L, (lua_Integer)n );
+    if( n == -1 )
+    {
+        if( errno == EAGAIN || errno == EWOULDBLOCK ){
+            buf_stat( b, again, 1 );
+        }
+        lua_pushstring( L, strerror( errno ) );
+        lua_pushboolean( L, errno == EAGAIN || errno == EWOULDBLOCK );
+        return 3;
+    }
+    else if( (size_t)n < nmsg ){
+        buf_stat( b, shortwrites, 1 );
+    }
+    
+    return 1;
+}
+
+
+static int messages_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    
+    lua_pushinteger( L, (lua_Integer)b->nmsg );
+    
+    return 1;
+}
+
+
+static int message_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    lua_Integer idx = luaL_checkinteger( L, 2 );
+    
+    if( idx < 1 || idx > (lua_Integer)b->nmsg ){
+        lua_pushnil( L );
+        return 1;
+    }
+    // head and tail of the datagram, and whether it was truncated
+    lua_pushinteger( L, (lua_Integer)b->msgoff[idx - 1] + 1 );
+    lua_pushinteger( L, (lua_Integer)( b->msgoff[idx - 1] + 
+                                       b->msglen[idx - 1] ) );
+    lua_pushboolean( L, b->msgtrunc[idx - 1] );
+    
+    return 3;
+}
+
+
+static int free_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    
+    if( b->pinned ){
+        return luaL_error( L, "attempted to free the memory in use by the "
+                              "pending operations" );
+    }
+    else if( b->mem )
+    {
+        buf_stat_alloc( b, b->total, 0 );
+        pdealloc( b->mem );
+        b->mem = NULL;
+        b->used = b->total = b->nalloc = 0;
+        pdealloc( b->msgoff );
+        pdealloc( b->msglen );
+        pdealloc( b->msgtrunc );
+        b->msgoff = b->msglen = NULL;
+        b->msgtrunc = NULL;
+        b->nmsg = b->msgcap = 0;
+        b->gen++;
+        buf_uncache( L, b );
+        buf_unlink( b );
+        buf_unaccount( b );
+        b->wmhigh = 0;
+        if( b->cloexec && b->fd != -1 ){
+            close( b->fd );
+        }
+    }
+    
+    return 0;
+}
+
+
+static int gc_lua( lua_State *L )
+{
+    buf_t *b = (buf_t*)lua_touserdata( L, 1 );
+    
+    // the pinned memory is leaked rather than freed while the kernel may
+    // write to it. it can happen only if the uring object is collected in
+    // the same cycle.
+    pdealloc( b->msgoff );
+    pdealloc( b->msglen );
+    pdealloc( b->msgtrunc );
+    buf_uncache( L, b );
+    buf_unlink( b );
+    buf_unaccount( b );
+    if( b->mem && !b->pinned )
+    {
+        buf_stat_alloc( b, b->total, 0 );
+        pdealloc( b->mem );
+        if( b->cloexec && b->fd != -1 ){
+            close( b->fd );
+        }
+    }
+    
+    return 0;
+}
+
+
+#if !defined(BUFFER_NO_STATS)
+
+static inline void bufstats_push( lua_State *L, bufstats_t *stats, 
+                                  uint64_t total )
+{
+    lua_createtable( L, 0, 9 );
+    lstate_num2tbl( L, "realloc", stats->realloc );
+    lstate_num2tbl( L, "moved", stats->moved );
+    lstate_num2tbl( L, "copied", stats->copied );
+    lstate_num2tbl( L, "reads", stats->reads );
+    lstate_num2tbl( L, "writes", stats->writes );
+    lstate_num2tbl( L, "again", stats->again );
+    lstate_num2tbl( L, "shortwrites", stats->shortwrites );
+    lstate_num2tbl( L, "peak", stats->peak );
+    lstate_num2tbl( L, "total", total );
+}
+
+#endif
+
+
+static int reclaim_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    lua_Integer low = luaL_optinteger( L, 2, 0 );
+    lua_Integer high = luaL_optinteger( L, 3, 0 );
+    
+    // check arguments
+    if( low < 0 ){
+        return luaL_argerror( L, 2, "low must be unsigned int" );
+    }
+    else if( high < 0 || ( high && high < low ) ){
+        return luaL_argerror( L, 3, "high must be 0 or larger than low" );
+    }
+    b->memlow = (size_t)low;
+    b->memhigh = (size_t)high;
+    
+    return 0;
+}
+
+
+static int watermark_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    lua_Integer low = luaL_optinteger( L, 2, 0 );
+    lua_Integer high = luaL_optinteger( L, 3, 0 );
+    
+    // check arguments
+    if( low < 0 ){
+        return luaL_argerror( L, 2, "low must be unsigned int" );
+    }
+    else if( high < 0 || ( high && high < low ) ){
+        return luaL_argerror( L, 3, "high must be 0 or larger than low" );
+    }
+    
+    buf_unaccount( b );
+    b->wmlow = (size_t)low;
+    b->wmhigh = (size_t)high;
+    buf_account( b );
+    lua_pushboolean( L, b->wmabove );
+    
+    return 1;
+}
+
+
+static int pending_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    
+    lua_pushinteger( L, (lua_Integer)( b->used > b->cur ? 
+                                       b->used - b->cur : 0 ) );
+    lua_pushboolean( L, b->wmabove );
+    
+    return 2;
+}
+
+
+static int stats_lua( lua_State *L )
+{
+#if defined(BUFFER_NO_STATS)
+    (void)checkudata( L );
+    lua_newtable( L );
+#else
+    buf_t *b = checkudata( L );
+    
+    bufstats_push( L, &b->stats, b->total );
+#endif
+    
+    return 1;
+}
+
+
+static int trim_lua( lua_State *L )
+{
+    lua_Integer max_idle = luaL_optinteger( L, 1, -1 );
+    buflist_t *list = NULL;
+    buf_t *b = NULL;
+    lua_Integer nbuf = 0;
+    size_t bytes = 0;
+    
+    lua_getfield( L, LUA_REGISTRYINDEX, BUFFER_LIVE_KEY );
+    list = (buflist_t*)lua_touserdata( L, -1 );
+    lua_pop( L, 1 );
+    
+    // shrink the empty buffers
+    for( b = list ? list->head : NULL; b; b = b->next )
+    {
+        size_t limit = max_idle < 0 ? b->memlow : (size_t)max_idle;
+        
+        buf_uncache_stale( L, b );
+        if( b->mem && !b->used && b->total > limit )
+        {
+            size_t n = buf_shrink( b, limit );
+            
+            if( n ){
+                nbuf++;
+                bytes += n;
+            }
+        }
+    }
+    
+    lua_pushinteger( L, nbuf );
+    lua_pushinteger( L, (lua_Integer)bytes );
+    
+    return 2;
+}
+
+
+static int pending_global_lua( lua_State *L )
+{
+    lua_pushinteger( L, (lua_Integer)__atomic_load_n( &BUF_PENDING, 
+                                                      __ATOMIC_RELAXED ) );
+    
+    return 1;
+}
+
+
+static int stats_global_lua( lua_State *L )
+{
+#if defined(BUFFER_NO_STATS)
+    lua_newtable( L );
+#else
+    bufstats_t stats;
+    
+    stats.realloc = __atomic_load_n( &BUF_STATS.realloc, __ATOMIC_RELAXED );
+    stats.moved = __atomic_load_n( &BUF_STATS.moved, __ATOMIC_RELAXED );
+    stats.copied = __atomic_load_n( &BUF_STATS.copied, __ATOMIC_RELAXED );
+    stats.reads = __atomic_load_n( &BUF_STATS.reads, __ATOMIC_RELAXED );
+    stats.writes = __atomic_load_n( &BUF_STATS.writes, __ATOMIC_RELAXED );
+    stats.again = __atomic_load_n( &BUF_STATS.again, __ATOMIC_RELAXED );
+    stats.shortwrites = __atomic_load_n( &BUF_STATS.shortwrites, 
+                                         __ATOMIC_RELAXED );
+    stats.peak = __atomic_load_n( &BUF_STATS.peak, __ATOMIC_RELAXED );
+    bufstats_push( L, &stats, 
+                   __atomic_load_n( &BUF_STATS_TOTAL, __ATOMIC_RELAXED ) );
+#endif
+    
+    return 1;
+}
+
+
+static int workers_lua( lua_State *L )
+{
+    if( lua_gettop( L ) > 0 )
+    {
+        lua_Integer n = luaL_checkinteger( L, 1 );
+        lua_Integer threshold = luaL_optinteger( L, 2, 
+                                                 (lua_Integer)wpool_threshold() );
+        
+        if( n > WPOOL_MAXTHREAD ){
+            return luaL_argerror( L, 1, "too many workers" );
+        }
+        else if( threshold < 0 ){
+            return luaL_argerror( L, 2, "threshold must be larger than 0" );
+        }
+        wpool_config( n < 0 ? -1 : (int)n, (size_t)threshold );
+    }
+    
+    lua_pushinteger( L, wpool_nconf() );
+    lua_pushinteger( L, (lua_Integer)wpool_threshold() );
+    
+    return 2;
+}
+
+
+static int profile_lua( lua_State *L )
+{
+#if defined(BUFFER_NO_STATS)
+    lua_pushboolean( L, 0 );
+#else
+    int probe = buf_probing();
+    
+    if( !lua_isnoneornil( L, 1 ) )
+    {
+        luaL_checktype( L, 1, LUA_TBOOLEAN );
+        if( lua_toboolean( L, 1 ) ){
+            __atomic_fetch_or( &BUF_PROBE, BUF_PROBE_HIST, __ATOMIC_RELAXED );
+        }
+        else {
+            __atomic_fetch_and( &BUF_PROBE, ~BUF_PROBE_HIST, 
+                                __ATOMIC_RELAXED );
+        }
+    }
+    
+    // previous state
+    lua_pushboolean( L, probe & BUF_PROBE_HIST );
+#endif
+    
+    return 1;
+}
+
+
+#if !defined(BUFFER_NO_STATS)
+
+static inline void bufhist_push( lua_State *L, const char *k, int hist, 
+                                 int reset )
+{
+    int i = 0;
+    
+    lua_pushstring( L, k );
+    lua_createtable( L, BUF_HIST_NBUCKET - 1, 1 );
+    for(; i < BUF_HIST_NBUCKET; i++ ){
+        lua_pushnumber( L, reset ? 
+            __atomic_exchange_n( &BUF_HIST[hist][i], 0, __ATOMIC_RELAXED ) :
+            __atomic_load_n( &BUF_HIST[hist][i], __ATOMIC_RELAXED )
+        );
+        lua_rawseti( L, -2, i );
+    }
+    lua_rawset( L, -3 );
+}
+
+#endif
+
+
+static int histograms_lua( lua_State *L )
+{
+#if defined(BUFFER_NO_STATS)
+    lua_newtable( L );
+#else
+    int reset = lua_toboolean( L, 1 );
+    
+    lua_createtable( L, 0, 2 );
+    lua_pushstring( L, "read" );
+    lua_createtable( L, 0, 2 );
+    bufhist_push( L, "nsec", BUF_HIST_READ_NSEC, reset );
+    bufhist_push( L, "bytes", BUF_HIST_READ_BYTES, reset );
+    lua_rawset( L, -3 );
+    lua_pushstring( L, "write" );
+    lua_createtable( L, 0, 2 );
+    bufhist_push( L, "nsec", BUF_HIST_WRITE_NSEC, reset );
+    bufhist_push( L, "bytes", BUF_HIST_WRITE_BYTES, reset );
+    lua_rawset( L, -3 );
+#endif
+    
+    return 1;
+}
+
+
+static int tostring_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    
+    if( !buf_cached( L, b, BUF_CACHE_STR ) ){
+        buf_stat( b, copied, b->used );
+        lua_pushlstring( L, b->mem, (size_t)b->used );
+        buf_cache( L, b, BUF_CACHE_STR );
+    }
+    
+    return 1;
+}
+
+
+static int len_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    
+    lua_pushinteger( L, (lua_Integer)b->used );
+    
+    return 1;
+}
+
+
+static int eq_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    buf_t *other = NULL;
+    size_t len = 0;
+    const char *str = NULL;
+    
+    switch( lua_type( L, 2 ) ){
+        case LUA_TSTRING:
+            str = lua_tolstring( L, 2, &len );
+            // the same string as the cached one
+            if( len == b->used && buf_cached( L, b, BUF_CACHE_STR ) )
+            {
+                int eq = lua_rawequal( L, 2, -1 );
+                
+                lua_pop( L, 1 );
+                if( eq ){
+                    lua_pushboolean( L, 1 );
+                    return 1;
+                }
+            }
+        break;
+        case LUA_TUSERDATA:
+            // compare the contents of the buffers without the copies
+            if( ( other = lbuf_test( L, 2 ) ) )
+            {
+                if( other->mem ){
+                    str = other->mem;
+                    len = other->used;
+                }
+            }
+            else if( lua_getmetatable( L, 2 ) )
+            {
+                lua_pop( L, 1 );
+                if( luaL_callmeta( L, 2, "__tostring" ) ){
+                    str = lua_tolstring( L, -1, &len );
+                }
+            }
+        break;
+    }
+    
+    lua_pushboolean( L, str && len == b->used && 
+                     ( str == b->mem || memcmp( str, b->mem, b->used ) == 0 ) );
+    return 1;
+}
+
+
+// zlib stream
+typedef struct {
+    z_stream strm;
+    int deflating;
+    int done;
+} zstream_t;
+
+enum {
+    ZSTREAM_DEFLATE = 0,
+    ZSTREAM_GZIP,
+    ZSTREAM_RAW,
+    ZSTREAM_AUTO
+};
+
+static const char *const ZSTREAM_FORMAT[] = {
+    "deflate", "gzip", "raw", "auto", NULL
+};
+
+
+static inline int zstream_wbits( int format, int deflating )
+{
+    switch( format ){
+        case ZSTREAM_GZIP:
+            return MAX_WBITS + 16;
+        case ZSTREAM_RAW:
+            return -MAX_WBITS;
+        case ZSTREAM_AUTO:
+            // automatic zlib or gzip header detection
+            return deflating ? MAX_WBITS : MAX_WBITS + 32;
+        default:
+            return MAX_WBITS;
+    }
+}
+
+
+static inline int zstream_init( zstream_t *z, int deflating, int level, 
+                                int format )
+{
+    int wbits = zstream_wbits( format, deflating );
+    
+    memset( z, 0, sizeof( zstream_t ) );
+    z->deflating = deflating;
+    if( deflating ){
+        return deflateInit2( &z->strm, level, Z_DEFLATED, wbits, 8, 
+                             Z_DEFAULT_STRATEGY );
+    }
+    
+    return inflateInit2( &z->strm, wbits );
+}
+
+
+static inline void zstream_end( zstream_t *z )
+{
+    if( z->deflating ){
+        deflateEnd( &z->strm );
+    }
+    else {
+        inflateEnd( &z->strm );
+    }
+}
+
+
+// compress/decompress len bytes of src into the tail of dst.
+// len will be set to the number of bytes that not consumed.
+static inline int zstream_pump( zstream_t *z, buf_t *dst, unsigned char *src,
+                                size_t *len, int flush )
+{
+    z_stream *strm = &z->strm;
+    size_t remain = *len;
+    int rc = Z_OK;
+    
+    strm->next_in = src;
+    strm->avail_in = 0;
+    for(;;)
+    {
+        size_t hint = 0;
+        size_t avail = 0;
+        
+        // refill input
+        if( !strm->avail_in && remain ){
+            strm->avail_in = ( remain > UINT_MAX ) ? UINT_MAX : (uInt)remain;
+            remain -= strm->avail_in;
+        }
+        
+        // preallocate output space
+        if( z->deflating ){
+            hint = deflateBound( strm, strm->avail_in );
+        }
+        else {
+            hint = strm->avail_in * 2;
+            if( hint < dst->used ){
+                hint = dst->used;
+            }
+        }
+        if( hint < 1024 ){
+            hint = 1024;
+        }
+        else if( hint > UINT_MAX ){
+            hint = UINT_MAX;
+        }
+        if( buf_increase( dst, dst->used, hint + 1 ) != 0 ){
+            rc = Z_MEM_ERROR;
+            break;
+        }
+        avail = dst->total - dst->used - 1;
+        if( avail > UINT_MAX ){
+            avail = UINT_MAX;
+        }
+        strm->next_out = (Bytef*)dst->mem + dst->used;
+        strm->avail_out = (uInt)avail;
+        
+        if( z->deflating ){
+            rc = deflate( strm, remain ? Z_NO_FLUSH : flush );
+        }
+        else {
+            rc = inflate( strm, Z_NO_FLUSH );
+        }
+        buf_term( dst, dst->used + ( avail - strm->avail_out ) );
+        
+        if( rc == Z_STREAM_END ){
+            z->done = 1;
+            break;
+        }
+        // need more input
+        else if( rc == Z_BUF_ERROR ){
+            if( strm->avail_out ){
+                rc = Z_OK;
+                break;
+            }
+        }
+        else if( rc != Z_OK ){
+            break;
+        }
+        // all input consumed and all output flushed
+        else if( !strm->avail_in && !remain && strm->avail_out ){
+            break;
+        }
+    }
+    
+    *len = remain + strm->avail_in;
+    
+    return rc;
+}
+
+
+static inline void zstream_pusherror( lua_State *L, zstream_t *z, int rc )
+{
+    if( rc == Z_MEM_ERROR ){
+        lua_pushstring( L, strerror( errno ? errno : ENOMEM ) );
+    }
+    else if( z->strm.msg ){
+        lua_pushstring( L, z->strm.msg );
+    }
+    else {
+        lua_pushstring( L, zError( rc ) );
+    }
+}
+
+
+static inline buf_t *checkdstudata( lua_State *L, int idx, buf_t *b )
+{
+    buf_t *dst = optdstudata( L, idx, b );
+    
+    if( dst == b ){
+        luaL_argerror( L, idx, "destination buffer must not be the source" );
+    }
+    
+    return dst;
+}
+
+
+static int deflate_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    buf_t *dst = checkdstudata( L, 2, b );
+    int level = (int)luaL_optinteger( L, 3, Z_DEFAULT_COMPRESSION );
+    int format = luaL_checkoption( L, 4, "deflate", ZSTREAM_FORMAT );
+    size_t pos = dst->used;
+    size_t len = b->used;
+    zstream_t z;
+    int rc = 0;
+    
+    if( format == ZSTREAM_AUTO ){
+        format = ZSTREAM_DEFLATE;
+    }
+    if( ( rc = zstream_init( &z, 1, level, format ) ) != Z_OK ){
+        zstream_pusherror( L, &z, rc );
+        return 1;
+    }
+    
+    rc = zstream_pump( &z, dst, (unsigned char*)b->mem, &len, Z_FINISH );
+    if( rc == Z_STREAM_END ){
+        deflateEnd( &z.strm );
+        return 0;
+    }
+    
+    // got error
+    zstream_pusherror( L, &z, rc );
+    deflateEnd( &z.strm );
+    buf_term( dst, pos );
+    
+    return 1;
+}
+
+
+static int inflate_lua( lua_State *L )
+{
+    buf_t *b = checkudata( L );
+    buf_t *dst = checkdstudata( L, 2, b );
+    int format = luaL_checkoption( L, 3, "auto", ZSTREAM_FORMAT );
+    size_t pos = dst->used;
+    size_t len = b->used;
+    zstream_t z;
+    int rc = 0;
+    
+    if( ( rc = zstream_init( &z, 0, 0, format ) ) != Z_OK ){
+        zstream_pusherror( L, &z, rc );
+        return 1;
+    }
+    
+    rc = zstream_pump( &z, dst, (unsigned char*)b->mem, &len, Z_FINISH );
+    if( rc == Z_STREAM_END ){
+        inflateEnd( &z.strm );
+        return 0;
+    }
+    // truncated stream
+    else if( rc == Z_OK ){
+        rc = Z_BUF_ERROR;
+        z.strm.msg = "unexpected end of stream";
+    }
+    
+    // got error
+    zstream_pusherror( L, &z, rc );
+    inflateEnd( &z.strm );
+    buf_term( dst, pos );
+    
+    return 1;
+}
+
+
+#define checkzstream(L,tname) ({ \
+    zstream_t *_z = (zstream_t*)luaL_checkudata( L, 1, tname ); \
+    if( !_z->strm.state ){ \
+        return luaL_error( L, "attempted to access already closed stream" ); \
+    } \
+    _z; \
+})
+
+// consume the contents of src and append the output to dst
+static inline int zstream_update( lua_State *L, zstream_t *z, int flush )
+{
+    buf_t *src = checkbufudata( L, 2 );
+    buf_t *dst = checkbufudata( L, 3 );
+    size_t len = src->used;
+    int rc = 0;
+    
+    if( src == dst ){
+        return luaL_argerror( L, 3, "destination buffer must not be the source" );
+    }
+    // the consumed bytes are removed from src
+    else if( buf_writable( src, 0 ) != 0 ){
+        lua_pushstring( L, strerror( errno ) );
+        return -1;
+    }
+    
+    rc = zstream_pump( z, dst, (unsigned char*)src->mem, &len, flush );
+    if( rc == Z_OK || rc == Z_STREAM_END )
+    {
+        // remove consumed bytes
+        if( len ){
+            memmove( src->mem, (char*)src->mem + src->used - len, len );
+        }
+        src->cur = 0;
+        buf_touch( src, 0 );
+        buf_term( src, len );
+        return 0;
+    }
+    
+    // got error
+    zstream_pusherror( L, z, rc );
+    
+    return -1;
+}
+
+
+static int deflater_update_lua( lua_State *L )
+{
+    zstream_t *z = checkzstream( L, DEFLATER_MT );
+    
+    return zstream_update( L, z, Z_NO_FLUSH ) ? 1 : 0;
+}
+
+
+static int deflater_flush_lua( lua_State *L )
+{
+    zstream_t *z = checkzstream( L, DEFLATER_MT );
+    
+    return zstream_update( L, z, Z_SYNC_FLUSH ) ? 1 : 0;
+}
+
+
+static int deflater_finish_lua( lua_State *L )
+{
+    zstream_t *z = checkzstream( L, DEFLATER_MT );
+    
+    return zstream_update( L, z, Z_FINISH ) ? 1 : 0;
+}
+
+
+static int inflater_update_lua( lua_State *L )
+{
+    zstream_t *z = checkzstream( L, INFLATER_MT );
+    
+    if( !z->done && zstream_update( L, z, Z_NO_FLUSH ) ){
+        lua_pushboolean( L, 0 );
+        lua_insert( L, -2 );
+        return 2;
+    }
+    lua_pushboolean( L, z->done );
+    
+    return 1;
+}
+
+
+static inline zstream_t *checkzstream_any( lua_State *L )
+{
+    zstream_t *z = (zstream_t*)lua_touserdata( L, 1 );
+    int valid = 0;
+    
+    if( z && lua_getmetatable( L, 1 ) ){
+        luaL_getmetatable( L, DEFLATER_MT );
+        luaL_getmetatable( L, INFLATER_MT );
+        valid = lua_rawequal( L, -3, -2 ) || lua_rawequal( L, -3, -1 );
+        lua_pop( L, 3 );
+    }
+    if( !valid ){
+        luaL_argerror( L, 1, DEFLATER_MT " or " INFLATER_MT " expected" );
+    }
+    
+    return z;
+}
+
+
+static int zstream_gc_lua( lua_State *L )
+{
+    zstream_t *z = (zstream_t*)lua_touserdata( L, 1 );
+    
+    if( z->strm.state ){
+        zstream_end( z );
+    }
+    
+    return 0;
+}
+
+
+static int zstream_reset_lua( lua_State *L )
+{
+    zstream_t *z = checkzstream_any( L );
+    
+    if( !z->strm.state ){
+        return luaL_error( L, "attempted to access already closed stream" );
+    }
+    z->done = 0;
+    if( z->deflating ){
+        deflateReset( &z->strm );
+    }
+    else {
+        inflateReset( &z->strm );
+    }
+    
+    return 0;
+}
+
+
+static int zstream_close_lua( lua_State *L )
+{
+    zstream_t *z = checkzstream_any( L );
+    
+    if( z->strm.state ){
+        zstream_end( z );
+        z->strm.state = NULL;
+    }
+    
+    return 0;
+}
+
+
+static inline int zstream_new( lua_State *L, int deflating, int level, 
+                               int format, const char *tname )
+{
+    zstream_t *z = lua_newuserdata( L, sizeof( zstream_t ) );
+    int rc = 0;
+    
+    if( ( rc = zstream_init( z, deflating, level, format ) ) == Z_OK ){
+        luaL_getmetatable( L, tname );
+        lua_setmetatable( L, -2 );
+        return 1;
+    }
+    
+    // got error
+    lua_pushnil( L );
+    zstream_pusherror( L, z, rc );
+    
+    return 2;
+}
+
+
+static int deflater_lua( lua_State *L )
+{
+    int level = (int)luaL_optinteger( L, 1, Z_DEFAULT_COMPRESSION );
+    int format = luaL_checkoption( L, 2, "deflate", ZSTREAM_FORMAT );
+    
+    if( format == ZSTREAM_AUTO ){
+        format = ZSTREAM_DEFLATE;
+    }
+    
+    return zstream_new( L, 1, level, format, DEFLATER_MT );
+}
+
+
+static int inflater_lua( lua_State *L )
+{
+    int format = luaL_checkoption( L, 1, "auto", ZSTREAM_FORMAT );
+    
+    return zstream_new( L, 0, 0, format, INFLATER_MT );
+}
+
+
+// multi-pattern matcher
+typedef struct {
+    acm_t acm;
+    // state of the stream
+    uint32_t state;
+    // number of bytes scanned
+    size_t pos;
+    // bytes held back by replace that can be a prefix of a match
+    unsigned char *pending;
+    size_t npending;
+} matcher_t;
+
+
+#define checkmatcher(L) ({ \
+    matcher_t *_m = (matcher_t*)luaL_checkudata( L, 1, MATCHER_MT ); \
+    if( !_m->acm.delta ){ \
+        return luaL_error( L, "attempted to access already freed matcher" ); \
+    } \
+    _m; \
+})
+
+
+static inline void matcher_reset( matcher_t *m )
+{
+    m->state = 0;
+    m->pos = 0;
+    m->npending = 0;
+}
+
+
+// returns the bytes of b that have not been scanned by the previous call
+// with more, and remember the position to resume.
+static inline const unsigned char *matcher_input( buf_t *b, int more, 
+                                                  size_t *len )
+{
+    size_t from = b->matchpos <= b->used ? b->matchpos : 0;
+    
+    b->matchpos = more ? b->used : 0;
+    *len = b->used - from;
+    
+    return (const unsigned char*)b->mem + from;
+}
+
+
+static int matcher_findall_lua( lua_State *L )
+{
+    matcher_t *m = checkmatcher( L );
+    buf_t *b = checkbufudata( L, 2 );
+    int more = lua_toboolean( L, 3 );
+    acm_t *acm = &m->acm;
+    size_t used = 0;
+    const unsigned char *mem = matcher_input( b, more, &used );
+    uint32_t s = m->state;
+    size_t i = 0;
+    int n = 0;
+    
+    lua_newtable( L );
+    for(; i < used; i++ )
+    {
+        s = acm_next( acm, s, mem[i] );
+        if( acm->out[s] )
+        {
+            size_t tail = m->pos + i + 1;
+            
+            // { head, tail, index } of the stream position
+            lua_createtable( L, 3, 0 );
+            lua_pushinteger( L, (lua_Integer)( tail - 
+                                acm->plen[acm->out[s] - 1] + 1 ) );
+            lua_rawseti( L, -2, 1 );
+            lua_pushinteger( L, (lua_Integer)tail );
+            lua_rawseti( L, -2, 2 );
+            lua_pushinteger( L, (lua_Integer)acm->out[s] );
+            lua_rawseti( L, -2, 3 );
+            lua_rawseti( L, -2, ++n );
+            // restart from the root
+            s = 0;
+        }
+    }
+    
+    if( more ){
+        m->state = s;
+        m->pos += used;
+    }
+    else {
+        matcher_reset( m );
+    }
+    
+    return 1;
+}
+
+
+// append the stream bytes of head-tail to dst. the bytes are in the pending
+// bytes or mem that starts at the stream position base.
+static inline int matcher_emit( matcher_t *m, buf_t *dst, 
+                                const unsigned char *mem, size_t base, 
+                                size_t head, size_t tail )
+{
+    size_t len = tail - head;
+    
+    if( !len ){
+        return 0;
+    }
+    else if( buf_increase( dst, dst->used, len + 1 ) != 0 ){
+        return -1;
+    }
+    else if( head < base )
+    {
+        size_t n = base - head;
+        const unsigned char *src = m->pending + m->npending - n;
+        
+        if( n > len ){
+            n = len;
+        }
+        memcpy( (char*)dst->mem + dst->used, src, n );
+        buf_term( dst, dst->used + n );
+        head += n;
+        len -= n;
+    }
+    memcpy( (char*)dst->mem + dst->used, mem + head - base, len );
+    buf_term( dst, dst->used + len );
+    
+    return 0;
+}
+
+
+static int matcher_replace_lua( lua_State *L )
+{
+    matcher_t *m = checkmatcher( L );
+    buf_t *b = checkbufudata( L, 2 );
+    buf_t *dst = checkdstudata( L, 3, b );
+    int more = lua_toboolean( L, 5 );
+    acm_t *acm = &m->acm;
+    size_t nmem = 0;
+    const unsigned char *mem = NULL;
+    size_t used = dst->used;
+    size_t scanned = b->matchpos;
+    // stream position of mem[0]
+    size_t base = m->pos;
+    // bytes before emitted are already written
+    size_t emitted = base - m->npending;
+    uint32_t s = m->state;
+    size_t i = 0;
+    int n = 0;
+    
+    // check arguments
+    // arg#4 replacement
+    if( lua_type( L, 4 ) != LUA_TTABLE ){
+        luaL_checkstring( L, 4 );
+    }
+    
+    mem = matcher_input( b, more, &nmem );
+    buf_touch( dst, used );
+    for(; i < nmem; i++ )
+    {
+        s = acm_next( acm, s, mem[i] );
+        if( acm->out[s] )
+        {
+            size_t tail = base + i + 1;
+            size_t head = tail - acm->plen[acm->out[s] - 1];
+            size_t len = 0;
+            const char *repl = NULL;
+            
+            if( lua_type( L, 4 ) == LUA_TTABLE ){
+                lua_rawgeti( L, 4, (int)acm->out[s] );
+            }
+            else {
+                lua_pushvalue( L, 4 );
+            }
+            // keep the match if no replacement
+            if( ( repl = lua_tolstring( L, -1, &len ) ) )
+            {
+                if( matcher_emit( m, dst, mem, base, emitted, head ) != 0 ||
+                    buf_increase( dst, dst->used, len + 1 ) != 0 ){
+                    goto FAILED;
+                }
+                memcpy( (char*)dst->mem + dst->used, repl, len );
+                buf_term( dst, dst->used + len );
+                emitted = tail;
+                n++;
+            }
+            lua_pop( L, 1 );
+            // restart from the root
+            s = 0;
+        }
+    }
+    
+    if( more )
+    {
+        size_t end = base + nmem;
+        // hold back the bytes that can be a prefix of a match
+        size_t hold = end - acm->depth[s];
+        
+        if( hold < emitted ){
+            hold = emitted;
+        }
+        if( matcher_emit( m, dst, mem, base, emitted, hold ) != 0 ){
+            goto FAILED;
+        }
+        // the held bytes are at most the longest pattern
+        if( hold < base ){
+            memmove( m->pending, m->pending + m->npending - ( base - hold ),
+                     base - hold );
+            m->npending = base - hold;
+            hold = base;
+        }
+        else {
+            m->npending = 0;
+        }
+        memcpy( m->pending + m->npending, mem + hold - base, end - hold );
+        m->npending += end - hold;
+        m->state = s;
+        m->pos = end;
+    }
+    else if( matcher_emit( m, dst, mem, base, emitted, 
+                           base + nmem ) != 0 ){
+        goto FAILED;
+    }
+    else {
+        matcher_reset( m );
+    }
+    
+    lua_pushinteger( L, n );
+    return 1;
+    
+FAILED:
+    // restore the destination and the position to resume
+    buf_term( dst, used );
+    b->matchpos = scanned;
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+    
+    return 2;
+}
+
+
+static int matcher_reset_lua( lua_State *L )
+{
+    matcher_t *m = checkmatcher( L );
+    
+    matcher_reset( m );
+    
+    return 0;
+}
+
+
+static int matcher_gc_lua( lua_State *L )
+{
+    matcher_t *m = (matcher_t*)lua_touserdata( L, 1 );
+    
+    acm_free( &m->acm );
+    pdealloc( m->pending );
+    m->pending = NULL;
+    
+    return 0;
+}
+
+
+static int matcher_lua( lua_State *L )
+{
+    size_t npat = 0;
+    const unsigned char **pats = NULL;
+    size_t *lens = NULL;
+    matcher_t *m = NULL;
+    size_t i = 0;
+    
+    // check arguments
+    luaL_checktype( L, 1, LUA_TTABLE );
+    if( !( npat = lua_objlen( L, 1 ) ) ){
+        return luaL_argerror( L, 1, "patterns must not be empty" );
+    }
+    
+    m = lua_newuserdata( L, sizeof( matcher_t ) );
+    memset( m, 0, sizeof( matcher_t ) );
+    luaL_getmetatable( L, MATCHER_MT );
+    lua_setmetatable( L, -2 );
+    
+    if( !( pats = pnalloc( npat, const unsigned char* ) ) || 
+        !( lens = pnalloc( npat, size_t ) ) ){
+        goto FAILED;
+    }
+    for(; i < npat; i++ )
+    {
+        lua_rawgeti( L, 1, (int)i + 1 );
+        if( lua_type( L, -1 ) != LUA_TSTRING || !lua_objlen( L, -1 ) ){
+            pdealloc( pats );
+            pdealloc( lens );
+            return luaL_argerror( L, 1, "pattern must be non-empty string" );
+        }
+        // the strings are referenced from the table of arg#1
+        pats[i] = (const unsigned char*)lua_tolstring( L, -1, lens + i );
+        lua_pop( L, 1 );
+    }
+    
+    if( acm_compile( &m->acm, pats, lens, npat ) == 0 && 
+        ( m->pending = pnalloc( m->acm.maxlen, unsigned char ) ) ){
+        pdealloc( pats );
+        pdealloc( lens );
+        return 1;
+    }
+    
+FAILED:
+    pdealloc( pats );
+    pdealloc( lens );
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+    
+    return 2;
+}
+
+
+// shared ring
+typedef struct {
+    ring_t *r;
+} lring_t;
+
+
+#define checkring(L) ({ \
+    lring_t *_ring = (lring_t*)luaL_checkudata( L, 1, RING_MT ); \
+    if( !_ring->r ){ \
+        return luaL_error( L, "attempted to access already closed ring" ); \
+    } \
+    _ring->r; \
+})
+
+
+static inline int ring_pusherror( lua_State *L, ssize_t len )
+{
+    lua_pushinteger( L, (lua_Integer)len );
+    if( len == -1 ){
+        lua_pushstring( L, strerror( errno ) );
+        lua_pushboolean( L, errno == EAGAIN || errno == EWOULDBLOCK );
+        return 3;
+    }
+    
+    return 1;
+}
+
+
+static int ring_push_lua( lua_State *L )
+{
+    ring_t *r = checkring( L );
+    size_t len = 0;
+    const char *str = NULL;
+    ssize_t rv = 0;
+    
+    if( lua_type( L, 2 ) == LUA_TUSERDATA ){
+        buf_t *src = checkbufudata( L, 2 );
+        
+        str = src->mem;
+        len = src->used;
+    }
+    else {
+        str = luaL_checklstring( L, 2, &len );
+    }
+    
+    if( len && !( rv = (ssize_t)ring_push( r, str, len ) ) ){
+        // ring is full
+        errno = EAGAIN;
+        rv = -1;
+    }
+    
+    return ring_pusherror( L, rv );
+}
+
+
+static int ring_pop_lua( lua_State *L )
+{
+    ring_t *r = checkring( L );
+    buf_t *dst = checkbufudata( L, 2 );
+    lua_Integer lbytes = luaL_optinteger( L, 3, 0 );
+    size_t bytes = SIZE_MAX;
+    struct iovec iov[2];
+    ssize_t rv = 0;
+    
+    // check arguments
+    if( lbytes < 0 ){
+        return luaL_argerror( L, 3, "bytes must be larger than 0" );
+    }
+    else if( lbytes ){
+        bytes = (size_t)lbytes;
+    }
+    
+    if( !( rv = (ssize_t)ring_readable( r, bytes, iov ) ) ){
+        // ring is empty
+        errno = EAGAIN;
+        rv = -1;
+    }
+    else
+    {
+        if( (size_t)rv > bytes ){
+            rv = (ssize_t)bytes;
+        }
+        if( buf_increase( dst, dst->used, (size_t)rv + 1 ) != 0 ){
+            rv = -1;
+        }
+        else {
+            ring_pop( r, dst->mem + dst->used, (size_t)rv );
+            buf_term( dst, dst->used + (size_t)rv );
+        }
+    }
+    
+    return ring_pusherror( L, rv );
+}
+
+
+static int ring_readfrom_lua( lua_State *L )
+{
+    ring_t *r = checkring( L );
+    int fd = luaL_checkint( L, 2 );
+    lua_Integer lbytes = luaL_optinteger( L, 3, 0 );
+    size_t bytes = SIZE_MAX;
+    struct iovec iov[2];
+    size_t len = 0;
+    ssize_t rv = -1;
+    
+    // check arguments
+    if( fd < 0 ){
+        return luaL_argerror( L, 2, "fd must be larger than 0" );
+    }
+    else if( lbytes < 0 ){
+        return luaL_argerror( L, 3, "bytes must be larger than 0" );
+    }
+    else if( lbytes ){
+        bytes = (size_t)lbytes;
+    }
+    
+    if( !( len = ring_writable( r, bytes, iov ) ) ){
+        // ring is full
+        errno = EAGAIN;
+    }
+    else if( ( rv = readv( fd, iov, 
+                           ring_trimiov( iov, len < bytes ? len : bytes ) ) ) > 0 ){
+        ring_commit( r, (size_t)rv );
+    }
+    
+    return ring_pusherror( L, rv );
+}
+
+
+static int ring_flushto_lua( lua_State *L )
+{
+    ring_t *r = checkring( L );
+    int fd = luaL_checkint( L, 2 );
+    struct iovec iov[2];
+    size_t len = 0;
+    ssize_t rv = 0;
+    
+    // check arguments
+    if( fd < 0 ){
+        return luaL_argerror( L, 2, "fd must be larger than 0" );
+    }
+    else if( ( len = ring_readable( r, SIZE_MAX, iov ) ) && 
+             ( rv = writev( fd, iov, ring_trimiov( iov, len ) ) ) > 0 ){
+        ring_consume( r, (size_t)rv );
+    }
+    
+    return ring_pusherror( L, rv );
+}
+
+
+static int ring_len_lua( lua_State *L )
+{
+    ring_t *r = checkring( L );
+    
+    lua_pushinteger( L, (lua_Integer)ring_len( r ) );
+    
+    return 1;
+}
+
+
+static int ring_cap_lua( lua_State *L )
+{
+    ring_t *r = checkring( L );
+    
+    lua_pushinteger( L, (lua_Integer)r->cap );
+    
+    return 1;
+}
+
+
+static int ring_handle_lua( lua_State *L )
+{
+    ring_t *r = checkring( L );
+    
+    // the reference is passed to the ring object created from the handle
+    ring_handle( r );
+    lua_pushlightuserdata( L, (void*)r );
+    
+    return 1;
+}
+
+
+static int ring_close_lua( lua_State *L )
+{
+    lring_t *ring = (lring_t*)luaL_checkudata( L, 1, RING_MT );
+    
+    if( ring->r ){
+        ring_release( ring->r );
+        ring->r = NULL;
+    }
+    
+    return 0;
+}
+
+
+static int ring_gc_lua( lua_State *L )
+{
+    lring_t *ring = (lring_t*)lua_touserdata( L, 1 );
+    
+    if( ring->r ){
+        ring_release( ring->r );
+    }
+    
+    return 0;
+}
+
+
+static int ring_lua( lua_State *L )
+{
+    lring_t *ring = NULL;
+    ring_t *r = NULL;
+    
+    // check arguments
+    // arg#1:handle
+    if( lua_type( L, 1 ) == LUA_TLIGHTUSERDATA )
+    {
+        r = (ring_t*)lua_touserdata( L, 1 );
+        if( ring_open( r ) != 0 ){
+            lua_pushnil( L );
+            lua_pushstring( L, strerror( errno ) );
+            return 2;
+        }
+    }
+    // arg#1:capacity
+    else
+    {
+        lua_Integer cap = luaL_checkinteger( L, 1 );
+        
+        if( cap < 1 ){
+            return luaL_argerror( L, 1, "capacity must be larger than 0" );
+        }
+        else if( !( r = ring_new( (size_t)cap ) ) ){
+            lua_pushnil( L );
+            lua_pushstring( L, strerror( errno ) );
+            return 2;
+        }
+    }
+    
+    ring = lua_newuserdata( L, sizeof( lring_t ) );
+    ring->r = r;
+    luaL_getmetatable( L, RING_MT );
+    lua_setmetatable( L, -2 );
+    
+    return 1;
+}
+
+
+// batched asynchronous read and flush
+enum {
+    BUFOP_READ = 0,
+    BUFOP_READADD,
+    BUFOP_FLUSH
+};
+
+static const char *const BUFOP_NAME[] = {
+    "read",
+    "readadd",
+    "flush"
+};
+
+typedef struct {
+    // NULL if the slot is free
+    buf_t *b;
+    int op;
+    // position of the contents to read into or to write from
+    size_t pos;
+    size_t len;
+    // number of bytes transferred, or -errno
+    ssize_t res;
+    // link of the free slots or the queue of the fallback
+    int next;
+} bufop_t;
+
+typedef struct {
+    uring_t ring;
+    int closed;
+    // operation slots. the buffers are referenced from the environment
+    // table at the index of the slot + 1
+    bufop_t *ops;
+    int nop;
+    int freeop;
+    // number of the operations queued, in flight or not reaped
+    int npending;
+    // queued and completed operations of the fallback
+    int qhead;
+    int qtail;
+    int dhead;
+    int dtail;
+    // index + 1 of the registered files by descriptor
+    int *fdidx;
+    int nfdidx;
+    // registered buffers
+    buf_t **regs;
+    int nreg;
+} luring_t;
+
+
+#define checkuring(L) ({ \
+    luring_t *_u = (luring_t*)luaL_checkudata( L, 1, URING_MT ); \
+    if( _u->closed ){ \
+        return luaL_error( L, "attempted to access already closed uring" ); \
+    } \
+    _u; \
+})
+
+
+static inline void bufop_enqueue( luring_t *u, int *head, int *tail, 
+                                  int idx )
+{
+    u->ops[idx].next = -1;
+    if( *tail == -1 ){
+        *head = idx;
+    }
+    else {
+        u->ops[*tail].next = idx;
+    }
+    *tail = idx;
+}
+
+
+static inline int bufop_dequeue( luring_t *u, int *head, int *tail )
+{
+    int idx = *head;
+    
+    if( idx != -1 && ( *head = u->ops[idx].next ) == -1 ){
+        *tail = -1;
+    }
+    
+    return idx;
+}
+
+
+static inline void bufop_release( luring_t *u, int idx )
+{
+    u->ops[idx].b->pinned--;
+    u->ops[idx].b->opbusy = 0;
+    u->ops[idx].b->opend = 0;
+    u->ops[idx].b = NULL;
+    u->ops[idx].next = u->freeop;
+    u->freeop = idx;
+    u->npending--;
+}
+
+
+// fallback: run the operation by the system call
+static inline ssize_t bufop_run( bufop_t *op )
+{
+    ssize_t rv = 0;
+    
+    if( op->op == BUFOP_FLUSH ){
+        rv = write( op->b->fd, (char*)op->b->mem + op->pos, op->len );
+    }
+    else {
+        rv = read( op->b->fd, (char*)op->b->mem + op->pos, op->len );
+    }
+    
+    return rv == -1 ? -errno : rv;
+}
+
+
+// reflect the result to the state of the buffer
+static inline void bufop_apply( bufop_t *op )
+{
+    buf_t *b = op->b;
+    
+    if( op->res == -EAGAIN || op->res == -EWOULDBLOCK ){
+        buf_stat( b, again, 1 );
+    }
+    
+    if( op->op == BUFOP_FLUSH )
+    {
+        buf_stat( b, writes, 1 );
+        if( op->res >= 0 )
+        {
+            if( (size_t)op->res < op->len ){
+                buf_stat( b, shortwrites, 1 );
+            }
+            b->cur += (size_t)op->res;
+            buf_account( b );
+            // reset buffer
+            if( b->cur >= b->used && !b->zcend ){
+                b->cur = 0;
+                buf_touch( b, 0 );
+                buf_term( b, 0 );
+            }
+        }
+    }
+    else
+    {
+        buf_stat( b, reads, 1 );
+        if( op->res > 0 ){
+            buf_term( b, op->pos + (size_t)op->res );
+            // rewind the write cursor
+            if( op->pos == 0 ){
+                b->cur = 0;
+            }
+        }
+    }
+}
+
+
+static inline int luring_queue( lua_State *L, int op )
+{
+    luring_t *u = checkuring( L );
+    buf_t *b = checkbufudata( L, 2 );
+    bufop_t *o = NULL;
+    int idx = u->freeop;
+    int fixed = -1;
+    int bufidx = -1;
+    size_t pos = 0;
+    size_t len = 0;
+    int i = 0;
+    
+    for(; i < u->nreg; i++ ){
+        if( u->regs[i] == b ){
+            bufidx = i;
+            break;
+        }
+    }
+    
+    if( op == BUFOP_FLUSH ){
+        pos = b->cur < b->used ? b->cur : b->used;
+        len = b->used - pos;
+    }
+    else
+    {
+        lua_Integer rbytes = luaL_optinteger( L, 3, 0 );
+        
+        // check arguments
+        // arg#3 bytes
+        if( rbytes < 0 ){
+            return luaL_argerror( L, 3, "bytes must be larger than 0" );
+        }
+        len = rbytes ? (size_t)rbytes : b->unit;
+        pos = op == BUFOP_READ ? 0 : b->used;
+        // registered buffer cannot grow. read up to the free space
+        if( bufidx != -1 && len >= b->total - pos ){
+            len = b->total - pos - 1;
+        }
+    }
+    
+    // all slots are in use, or the buffer is in use by the other operation
+    if( idx == -1 || b->opbusy ){
+        errno = EBUSY;
+        goto FAILED;
+    }
+    else if( op != BUFOP_FLUSH )
+    {
+        if( !len ){
+            errno = ENOBUFS;
+            goto FAILED;
+        }
+        if( buf_writable( b, pos ) != 0 || 
+            buf_increase( b, pos, len + 1 ) != 0 ){
+            goto FAILED;
+        }
+        buf_touch( b, pos );
+        // the contents are replaced. the bytes being overwritten by the
+        // kernel must not be read until the completion
+        if( op == BUFOP_READ ){
+            buf_term( b, 0 );
+        }
+    }
+    
+    o = u->ops + idx;
+    u->freeop = o->next;
+    if( u->ring.fd != -1 )
+    {
+        if( b->fd >= 0 && b->fd < u->nfdidx ){
+            fixed = u->fdidx[b->fd] - 1;
+        }
+        // submit the prepared entries if the submission queue is full
+        while( uring_prep( &u->ring, op == BUFOP_FLUSH ? URING_WRITE : 
+                           URING_READ, b->fd, fixed, (char*)b->mem + pos, 
+                           len, bufidx, (uint64_t)idx ) != 0 ){
+            if( errno != EBUSY || uring_submit( &u->ring, 0 ) == -1 ){
+                o->next = u->freeop;
+                u->freeop = idx;
+                goto FAILED;
+            }
+        }
+    }
+    else {
+        bufop_enqueue( u, &u->qhead, &u->qtail, idx );
+    }
+    
+    o->b = b;
+    o->op = op;
+    o->pos = pos;
+    o->len = len;
+    o->res = 0;
+    b->pinned++;
+    // the read rewrites the contents after pos, and the flush sends the
+    // contents before used
+    b->opbusy = 1;
+    b->opend = op == BUFOP_FLUSH ? b->used : SIZE_MAX;
+    u->npending++;
+    // keep the buffer alive until completion
+    lua_getfenv( L, 1 );
+    lua_pushvalue( L, 2 );
+    lua_rawseti( L, -2, idx + 1 );
+    
+    lua_pushboolean( L, 1 );
+    return 1;
+    
+FAILED:
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+    lua_pushboolean( L, errno == EBUSY );
+    
+    return 3;
+}
+
+
+static int luring_read_lua( lua_State *L )
+{
+    return luring_queue( L, BUFOP_READ );
+}
+
+
+static int luring_readadd_lua( lua_State *L )
+{
+    return luring_queue( L, BUFOP_READADD );
+}
+
+
+static int luring_flush_lua( lua_State *L )
+{
+    return luring_queue( L, BUFOP_FLUSH );
+}
+
+
+static int luring_submit_lua( lua_State *L )
+{
+    luring_t *u = checkuring( L );
+    lua_Integer wait = luaL_optinteger( L, 2, 0 );
+    int n = 0;
+    
+    // check arguments
+    // arg#2 wait
+    if( wait < 0 ){
+        return luaL_argerror( L, 2, "wait must be larger than 0" );
+    }
+    
+    if( u->ring.fd != -1 )
+    {
+        // do not wait for the operations that are not queued
+        if( wait > u->npending ){
+            wait = u->npending;
+        }
+        if( ( n = uring_submit( &u->ring, (unsigned)wait ) ) == -1 ){
+            lua_pushnil( L );
+            lua_pushstring( L, strerror( errno ) );
+            return 2;
+        }
+    }
+    // fallback: run the queued operations
+    else
+    {
+        int idx = 0;
+        
+        while( ( idx = bufop_dequeue( u, &u->qhead, &u->qtail ) ) != -1 ){
+            u->ops[idx].res = bufop_run( u->ops + idx );
+            bufop_enqueue( u, &u->dhead, &u->dtail, idx );
+            n++;
+        }
+    }
+    
+    lua_pushinteger( L, n );
+    return 1;
+}
+
+
+static int luring_complete_lua( lua_State *L )
+{
+    luring_t *u = checkuring( L );
+    bufop_t *o = NULL;
+    buf_t *b = NULL;
+    int idx = 0;
+    
+    if( u->ring.fd != -1 )
+    {
+        uint64_t data = 0;
+        int res = 0;
+        
+        do {
+            if( !uring_reap( &u->ring, &data, &res ) ){
+                return 0;
+            }
+        } while( data == URING_CANCEL_DATA );
+        idx = (int)data;
+        u->ops[idx].res = res;
+    }
+    else if( ( idx = bufop_dequeue( u, &u->dhead, &u->dtail ) ) == -1 ){
+        return 0;
+    }
+    
+    o = u->ops + idx;
+    b = o->b;
+    bufop_apply( o );
+    // release the reference
+    lua_getfenv( L, 1 );
+    lua_rawgeti( L, -1, idx + 1 );
+    lua_pushnil( L );
+    lua_rawseti( L, -3, idx + 1 );
+    lua_pushstring( L, BUFOP_NAME[o->op] );
+    if( o->res < 0 )
+    {
+        int err = (int)-o->res;
+        
+        bufop_release( u, idx );
+        lua_pushinteger( L, -1 );
+        lua_pushstring( L, strerror( err ) );
+        lua_pushboolean( L, err == EAGAIN || err == EWOULDBLOCK );
+        return 5;
+    }
+    lua_pushinteger( L, (lua_Integer)o->res );
+    bufop_release( u, idx );
+    // the memory cannot be shrunk while pinned by the operation
+    if( o->op == BUFOP_FLUSH ){
+        buf_reclaim( b );
+        buf_uncache_stale( L, b );
+    }
+    
+    return 3;
+}
+
+
+static int luring_files_lua( lua_State *L )
+{
+    luring_t *u = checkuring( L );
+    int n = 0;
+    int *fds = NULL;
+    int *fdidx = NULL;
+    int maxfd = -1;
+    int i = 0;
+    
+    // check arguments
+    // arg#2 descriptors
+    luaL_checktype( L, 2, LUA_TTABLE );
+    n = (int)lua_objlen( L, 2 );
+    if( n && !( fds = pnalloc( n, int ) ) ){
+        goto FAILED;
+    }
+    for(; i < n; i++ )
+    {
+        lua_rawgeti( L, 2, i + 1 );
+        if( !lua_isnumber( L, -1 ) || lua_tointeger( L, -1 ) < 0 ){
+            pdealloc( fds );
+            return luaL_argerror( L, 2, "descriptors must be unsigned int" );
+        }
+        fds[i] = (int)lua_tointeger( L, -1 );
+        lua_pop( L, 1 );
+        if( fds[i] > maxfd ){
+            maxfd = fds[i];
+        }
+    }
+    if( maxfd >= 0 && !( fdidx = pcalloc( maxfd + 1, int ) ) ){
+        goto FAILED;
+    }
+    
+    if( u->ring.fd != -1 )
+    {
+        if( u->nfdidx ){
+            uring_unregister_files( &u->ring );
+            pdealloc( u->fdidx );
+            u->fdidx = NULL;
+            u->nfdidx = 0;
+        }
+        if( n && uring_register_files( &u->ring, fds, (unsigned)n ) != 0 ){
+            pdealloc( fdidx );
+            goto FAILED;
+        }
+    }
+    for( i = 0; i < n; i++ ){
+        fdidx[fds[i]] = i + 1;
+    }
+    pdealloc( fds );
+    pdealloc( u->fdidx );
+    u->fdidx = fdidx;
+    u->nfdidx = maxfd + 1;
+    
+    lua_pushboolean( L, 1 );
+    return 1;
+    
+FAILED:
+    pdealloc( fds );
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+    
+    return 2;
+}
+
+
+static inline void luring_unregister( luring_t *u )
+{
+    int i = 0;
+    
+    if( u->nreg && u->ring.fd != -1 ){
+        uring_unregister_buffers( &u->ring );
+    }
+    for(; i < u->nreg; i++ ){
+        u->regs[i]->pinned--;
+    }
+    pdealloc( u->regs );
+    u->regs = NULL;
+    u->nreg = 0;
+}
+
+
+static int luring_register_lua( lua_State *L )
+{
+    luring_t *u = checkuring( L );
+    int n = 0;
+    buf_t **regs = NULL;
+    struct iovec *iov = NULL;
+    int i = 0;
+    
+    // check arguments
+    // arg#2 buffers
+    luaL_checktype( L, 2, LUA_TTABLE );
+    n = (int)lua_objlen( L, 2 );
+    if( n && ( !( regs = pnalloc( n, buf_t* ) ) || 
+               !( iov = pnalloc( n, struct iovec ) ) ) ){
+        goto FAILED;
+    }
+    for(; i < n; i++ )
+    {
+        lua_rawgeti( L, 2, i + 1 );
+        if( !( regs[i] = lbuf_test( L, -1 ) ) || !regs[i]->mem ){
+            pdealloc( regs );
+            pdealloc( iov );
+            return luaL_argerror( L, 2, "buffers must be buffer objects" );
+        }
+        lua_pop( L, 1 );
+        iov[i].iov_base = regs[i]->mem;
+        iov[i].iov_len = regs[i]->total;
+    }
+    
+    luring_unregister( u );
+    if( u->ring.fd != -1 && n && 
+        uring_register_buffers( &u->ring, iov, (unsigned)n ) != 0 ){
+        goto FAILED;
+    }
+    pdealloc( iov );
+    for( i = 0; i < n; i++ ){
+        regs[i]->pinned++;
+    }
+    u->regs = regs;
+    u->nreg = n;
+    // keep the buffers alive
+    lua_getfenv( L, 1 );
+    lua_pushvalue( L, 2 );
+    lua_setfield( L, -2, "regs" );
+    
+    lua_pushboolean( L, 1 );
+    return 1;
+    
+FAILED:
+    pdealloc( regs );
+    pdealloc( iov );
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+    
+    return 2;
+}
+
+
+static int luring_pending_lua( lua_State *L )
+{
+    luring_t *u = checkuring( L );
+    
+    lua_pushinteger( L, u->npending );
+    
+    return 1;
+}
+
+
+static int luring_backend_lua( lua_State *L )
+{
+    luring_t *u = checkuring( L );
+    
+    lua_pushstring( L, u->ring.fd != -1 ? "io_uring" : "sync" );
+    
+    return 1;
+}
+
+
+// cancel the pending operations and wait for them, then release everything
+static void luring_close( luring_t *u )
+{
+    int i = 0;
+    
+    if( u->ring.fd != -1 && u->npending )
+    {
+        uint64_t data = 0;
+        int res = 0;
+        
+        uring_submit( &u->ring, 0 );
+        for(; i < u->nop; i++ ){
+            if( u->ops[i].b ){
+                while( uring_cancel( &u->ring, (uint64_t)i ) != 0 && 
+                       uring_submit( &u->ring, 0 ) != -1 ){}
+            }
+        }
+        while( u->npending )
+        {
+            if( !uring_reap( &u->ring, &data, &res ) ){
+                if( uring_submit( &u->ring, 1 ) == -1 ){
+                    break;
+                }
+            }
+            else if( data != URING_CANCEL_DATA ){
+                bufop_release( u, (int)data );
+            }
+        }
+    }
+    // the operations of the fallback that are not reaped
+    for( i = 0; i < u->nop; i++ ){
+        if( u->ops[i].b ){
+            bufop_release( u, i );
+        }
+    }
+    luring_unregister( u );
+    uring_exit( &u->ring );
+    pdealloc( u->ops );
+    pdealloc( u->fdidx );
+    u->ops = NULL;
+    u->fdidx = NULL;
+    u->nop = u->nfdidx = 0;
+    u->closed = 1;
+}
+
+
+static int luring_close_lua( lua_State *L )
+{
+    luring_t *u = checkuring( L );
+    
+    luring_close( u );
+    // release the references
+    lua_newtable( L );
+    lua_setfenv( L, 1 );
+    
+    return 0;
+}
+
+
+static int luring_gc_lua( lua_State *L )
+{
+    luring_t *u = (luring_t*)lua_touserdata( L, 1 );
+    
+    if( !u->closed ){
+        luring_close( u );
+    }
+    
+    return 0;
+}
+
+
+static int luring_lua( lua_State *L )
+{
+    lua_Integer entries = luaL_checkinteger( L, 1 );
+    luring_t *u = NULL;
+    int i = 0;
+    
+    // check arguments
+    // arg#1 entries
+    if( entries < 1 || entries > 4096 ){
+        return luaL_argerror( L, 1, "entries must be 1-4096" );
+    }
+    
+    u = lua_newuserdata( L, sizeof( luring_t ) );
+    memset( u, 0, sizeof( luring_t ) );
+    u->closed = 1;
+    luaL_getmetatable( L, URING_MT );
+    lua_setmetatable( L, -2 );
+    lua_newtable( L );
+    lua_setfenv( L, -2 );
+    
+    // fallback to the system calls if io_uring is not available
+    if( uring_init( &u->ring, (unsigned)entries ) == 0 ){
+        u->nop = (int)u->ring.cq_entries;
+    }
+    else {
+        u->nop = (int)entries * 2;
+    }
+    if( !( u->ops = pcalloc( u->nop, bufop_t ) ) ){
+        uring_exit( &u->ring );
+        lua_pushnil( L );
+        lua_pushstring( L, strerror( errno ) );
+        return 2;
+    }
+    for(; i < u->nop; i++ ){
+        u->ops[i].next = i + 1 < u->nop ? i + 1 : -1;
+    }
+    u->freeop = 0;
+    u->qhead = u->qtail = u->dhead = u->dtail = -1;
+    u->closed = 0;
+    
+    return 1;
+}
+
+
+// group commit of the log records
+typedef struct {
+    int fd;
+    int closed;
+    // error of the sync. the records written after the failure may not be
+    // durable, so the writer cannot be used after that
+    int err;
+    // staged records
+    char *mem;
+    size_t len;
+    size_t cap;
+    // number of bytes of mem written but not synced
+    size_t written;
+    // references of the callbacks of the staged records in the environment
+    // table, or LUA_NOREF
+    int *refs;
+    size_t nrec;
+    size_t nref;
+    // sequence number of the last durable record
+    uint64_t seq;
+    // time of the first staged record
+    uint64_t since;
+    uint64_t max_delay;
+    size_t max_bytes;
+    // blocks are reserved by prealloc bytes before the appends
+    size_t prealloc;
+    off_t offset;
+    off_t reserved;
+} logwriter_t;
+
+
+#define checklogwriter(L) ({ \
+    logwriter_t *_w = (logwriter_t*)luaL_checkudata( L, 1, LOGWRITER_MT ); \
+    if( _w->closed ){ \
+        return luaL_error( L, "attempted to access already closed logwriter" ); \
+    } \
+    _w; \
+})
+
+
+static inline int logwriter_isdue( logwriter_t *w )
+{
+    return w->nrec && ( w->len >= w->max_bytes ||
+                        logf_msec() - w->since >= w->max_delay );
+}
+
+
+static int logwriter_append_lua( lua_State *L )
+{
+    logwriter_t *w = checklogwriter( L );
+    const char *data = NULL;
+    size_t len = 0;
+    int ref = LUA_NOREF;
+    
+    // check arguments
+    // arg#2 record
+    if( lua_type( L, 2 ) == LUA_TSTRING ){
+        data = lua_tolstring( L, 2, &len );
+    }
+    else {
+        buf_t *b = checkbufudata( L, 2 );
+        
+        data = b->mem;
+        len = b->used;
+    }
+    // arg#3 callback
+    if( !lua_isnoneornil( L, 3 ) ){
+        luaL_checktype( L, 3, LUA_TFUNCTION );
+    }
+    lua_settop( L, 3 );
+    
+    if( w->err ){
+        errno = w->err;
+        goto FAILED;
+    }
+    
+    // grow the staging area
+    if( w->cap - w->len < len )
+    {
+        size_t cap = w->cap ? w->cap : 4096;
+        char *mem = NULL;
+        
+        while( cap - w->len < len ){
+            if( cap > SIZE_MAX / 2 ){
+                errno = ENOMEM;
+                goto FAILED;
+            }
+            cap *= 2;
+        }
+        if( !( mem = prealloc( cap, char, w->mem ) ) ){
+            goto FAILED;
+        }
+        w->mem = mem;
+        w->cap = cap;
+    }
+    if( w->nrec == w->nref )
+    {
+        size_t nref = w->nref ? w->nref * 2 : 64;
+        int *refs = prealloc( nref, int, w->refs );
+        
+        if( !refs ){
+            goto FAILED;
+        }
+        w->refs = refs;
+        w->nref = nref;
+    }
+    
+    if( !lua_isnil( L, 3 ) ){
+        lua_getfenv( L, 1 );
+        lua_pushvalue( L, 3 );
+        ref = luaL_ref( L, -2 );
+        lua_pop( L, 1 );
+    }
+    if( !w->nrec ){
+        w->since = logf_msec();
+    }
+    memcpy( w->mem + w->len, data, len );
+    w->len += len;
+    w->refs[w->nrec++] = ref;
+    
+    // sequence number of the record
+    lua_pushnumber( L, (lua_Number)( w->seq + w->nrec ) );
+    lua_pushboolean( L, logwriter_isdue( w ) );
+    return 2;
+    
+FAILED:
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+    return 2;
+}
+
+
+// call the callbacks of n records from the sequence number seq+1 with err.
+// the error of a callback is raised after all callbacks are called.
+static int logwriter_notify( lua_State *L, int *refs, size_t n, uint64_t seq,
+                             int err )
+{
+    int failed = 0;
+    size_t i = 0;
+    
+    // environment table and the first error of the callbacks
+    lua_getfenv( L, 1 );
+    lua_pushnil( L );
+    for(; i < n; i++ )
+    {
+        if( refs[i] == LUA_NOREF ){
+            continue;
+        }
+        lua_rawgeti( L, -2, refs[i] );
+        luaL_unref( L, -3, refs[i] );
+        lua_pushnumber( L, (lua_Number)( seq + i + 1 ) );
+        if( err ){
+            lua_pushstring( L, strerror( err ) );
+        }
+        else {
+            lua_pushnil( L );
+        }
+        if( lua_pcall( L, 2, 0, 0 ) != 0 )
+        {
+            if( failed ){
+                lua_pop( L, 1 );
+            }
+            else {
+                lua_replace( L, -2 );
+                failed = 1;
+            }
+        }
+    }
+    pdealloc( refs );
+    
+    if( failed ){
+        return lua_error( L );
+    }
+    lua_pop( L, 2 );
+    
+    return 0;
+}
+
+
+// write and sync the staged records.
+// returns the number of records committed, or -1 with errno.
+static inline int logwriter_commit( lua_State *L, logwriter_t *w )
 {
-    buf_t *b = checkudata( L );
-    int fd = luaL_checkint( L, 2 );
+    int *refs = w->refs;
+    size_t nrec = w->nrec;
+    uint64_t seq = w->seq;
     
-    // check arguments
-    if( fd < 0 ){
-        return luaL_argerror( L, 2, "fd must be larger than 0" );
+    if( w->err ){
+        errno = w->err;
+        return -1;
     }
-    // cloexec
-    else if( lua_gettop( L ) > 2 ){
-        luaL_checktype( L, 3, LUA_TBOOLEAN );
-        b->cloexec = lua_toboolean( L, 3 );
+    else if( !nrec ){
+        return 0;
     }
-    b->fd = fd;
     
-    return 0;
+    // reserve the blocks of the records
+    if( w->prealloc && w->offset + (off_t)w->len > w->reserved )
+    {
+        size_t len = w->len > w->prealloc ? w->len : w->prealloc;
+        
+        if( logf_reserve( w->fd, w->offset, (off_t)len ) == 0 ){
+            w->reserved = w->offset + (off_t)len;
+        }
+        // not supported by the file system
+        else {
+            w->prealloc = 0;
+        }
+    }
+    
+    // the records that were written by the failed commit are not written
+    // again
+    w->written += logf_write( w->fd, w->mem + w->written,
+                              w->len - w->written );
+    if( w->written < w->len ){
+        return -1;
+    }
+    else if( logf_sync( w->fd ) != 0 ){
+        w->err = errno;
+    }
+    
+    // the callbacks may append the records. the records are not durable if
+    // the sync failed
+    w->offset += (off_t)w->len;
+    w->len = w->written = 0;
+    if( !w->err ){
+        w->seq += nrec;
+    }
+    w->refs = NULL;
+    w->nrec = w->nref = 0;
+    logwriter_notify( L, refs, nrec, seq, w->err );
+    if( w->err ){
+        errno = w->err;
+        return -1;
+    }
+    
+    return (int)( nrec > INT_MAX ? INT_MAX : nrec );
 }
 
 
-static int cloexec_lua( lua_State *L )
+static int logwriter_commit_lua( lua_State *L )
 {
-    buf_t *b = checkudata( L );
+    logwriter_t *w = checklogwriter( L );
+    int force = lua_toboolean( L, 2 );
+    int n = 0;
     
-    if( lua_gettop( L ) > 1 ){
-        luaL_checktype( L, 2, LUA_TBOOLEAN );
-        b->cloexec = lua_toboolean( L, 2 );
+    if( ( force || logwriter_isdue( w ) ) &&
+        ( n = logwriter_commit( L, w ) ) == -1 ){
+        lua_pushnil( L );
+        lua_pushstring( L, strerror( errno ) );
+        return 2;
     }
     
-    lua_pushboolean( L, b->cloexec );
+    // number of records committed
+    lua_pushinteger( L, n );
     
     return 1;
 }
 
 
-static inline int read2buf( lua_State *L, buf_t *b, size_t pos )
+static int logwriter_durable_lua( lua_State *L )
 {
-    size_t bytes = b->unit;
-    ssize_t len = 0;
-    lua_Integer rbytes = luaL_optinteger( L, 2, 0 );
-
-    // check arguments
-    // arg#2 bytes
-    if( rbytes < 0 ){
-        return luaL_argerror( L, 2, "bytes must be larger than 0" );
-    }
-    else if( rbytes ){
-        bytes = (size_t)rbytes;
-    }
+    logwriter_t *w = checklogwriter( L );
     
-    len = buf_read( b, pos, bytes );
-    // set number of bytes read
-    lua_pushinteger( L, (lua_Integer)len );
-    // got error
-    if( len == -1 ){
-        lua_pushstring( L, strerror( errno ) );
-        lua_pushboolean( L, errno == EAGAIN || errno == EWOULDBLOCK );
-        return 3;
-    }
-    // rewind the write cursor
-    else if( pos == 0 ){
-        b->cur = 0;
+    if( w->err ){
+        lua_pushnil( L );
+        lua_pushstring( L, strerror( w->err ) );
+        return 2;
     }
+    lua_pushnumber( L, (lua_Number)w->seq );
     
     return 1;
 }
 
 
-static int read_lua( lua_State *L )
+static int logwriter_pending_lua( lua_State *L )
 {
-    buf_t *b = checkudata( L );
-    return read2buf( L, b, 0 );
+    logwriter_t *w = checklogwriter( L );
+    
+    lua_pushinteger( L, (lua_Integer)w->nrec );
+    lua_pushinteger( L, (lua_Integer)w->len );
+    lua_pushboolean( L, logwriter_isdue( w ) );
+    
+    return 3;
 }
 
 
-static int readadd_lua( lua_State *L )
+static inline void logwriter_release( logwriter_t *w )
 {
-    buf_t *b = checkudata( L );
-    return read2buf( L, b, b->used );
+    pdealloc( w->mem );
+    pdealloc( w->refs );
+    w->mem = NULL;
+    w->refs = NULL;
+    w->len = w->cap = w->written = w->nrec = w->nref = 0;
+    w->closed = 1;
 }
 
 
-static int write_lua( lua_State *L )
+static int logwriter_close_lua( lua_State *L )
 {
-    buf_t *b = checkudata( L );
-    ssize_t len = 0;
-    struct iovec iov;
-    
-    iov.iov_base = (void*)luaL_checklstring( L, 2, &iov.iov_len );
-    if( iov.iov_base ){
-        len = writev( b->fd, &iov, 1 );
-    }
+    logwriter_t *w = checklogwriter( L );
     
-    // set number of bytes read
-    lua_pushinteger( L, (lua_Integer)len );
-    if( len == -1 ){
+    if( logwriter_commit( L, w ) == -1 ){
+        lua_pushnil( L );
         lua_pushstring( L, strerror( errno ) );
-        lua_pushboolean( L, errno == EAGAIN || errno == EWOULDBLOCK );
-        return 3;
+        return 2;
     }
+    logwriter_release( w );
+    // release the references
+    lua_newtable( L );
+    lua_setfenv( L, 1 );
+    lua_pushboolean( L, 1 );
     
     return 1;
 }
 
 
-static int flush_lua( lua_State *L )
+static int logwriter_gc_lua( lua_State *L )
 {
-    buf_t *b = checkudata( L );
-    ssize_t len = 0;
-    struct iovec iov;
-    
-    if( b->cur > b->used ){
-        b->cur = 0;
-    }
-    iov.iov_base = b->mem + b->cur;
-    iov.iov_len = b->used - b->cur;
+    logwriter_t *w = (logwriter_t*)lua_touserdata( L, 1 );
     
-    len = writev( b->fd, &iov, 1 );
-    if( len == -1 ){
-        lua_pushinteger( L, (lua_Integer)len );
-        lua_pushinteger( L, (lua_Integer)b->used );
-        lua_pushstring( L, strerror( errno ) );
-        lua_pushboolean( L, errno == EAGAIN || errno == EWOULDBLOCK );
-        return 4;
-    }
-    else
-    {
-        b->cur += (size_t)len;
-        // set number of bytes write
-        lua_pushinteger( L, (lua_Integer)b->cur );
-        // set total number of bytes buffer
-        lua_pushinteger( L, (lua_Integer)b->used );
-        // reset buffer
-        if( b->cur == b->used ){
-            b->cur = 0;
-            buf_term( b, 0 );
-        }
+    // the staged records are discarded
+    if( !w->closed ){
+        logwriter_release( w );
     }
     
-    return 2;
+    return 0;
 }
 
 
-static int free_lua( lua_State *L )
+static int logwriter_lua( lua_State *L )
 {
-    buf_t *b = checkudata( L );
+    lua_Integer fd = luaL_checkinteger( L, 1 );
+    lua_Number max_delay = 0;
+    lua_Integer max_bytes = LOGF_MAXBYTES;
+    lua_Integer prealloc = 0;
+    logwriter_t *w = NULL;
     
-    if( b->mem )
+    // check arguments
+    // arg#1 fd
+    if( fd < 0 || fd > INT_MAX ){
+        return luaL_argerror( L, 1, "fd must be unsigned int" );
+    }
+    // arg#2 options
+    else if( !lua_isnoneornil( L, 2 ) )
     {
-        pdealloc( b->mem );
-        b->mem = NULL;
-        b->used = b->total = b->nalloc = 0;
-        if( b->cloexec && b->fd != -1 ){
-            close( b->fd );
+        luaL_checktype( L, 2, LUA_TTABLE );
+        lua_getfield( L, 2, "max_delay" );
+        max_delay = luaL_optnumber( L, -1, 0 );
+        lua_getfield( L, 2, "max_bytes" );
+        max_bytes = luaL_optinteger( L, -1, LOGF_MAXBYTES );
+        lua_getfield( L, 2, "prealloc" );
+        prealloc = luaL_optinteger( L, -1, 0 );
+        lua_pop( L, 3 );
+        if( max_delay < 0 ){
+            return luaL_argerror( L, 2, "max_delay must be unsigned number" );
+        }
+        else if( max_bytes < 0 ){
+            return luaL_argerror( L, 2, "max_bytes must be unsigned int" );
+        }
+        else if( prealloc < 0 ){
+            return luaL_argerror( L, 2, "prealloc must be unsigned int" );
         }
     }
     
-    return 0;
-}
-
-
-static int gc_lua( lua_State *L )
-{
-    buf_t *b = (buf_t*)lua_touserdata( L, 1 );
-    
-    if( b->mem )
-    {
-        pdealloc( b->mem );
-        if( b->cloexec && b->fd != -1 ){
-            close( b->fd );
-        }
+    w = lua_newuserdata( L, sizeof( logwriter_t ) );
+    memset( w, 0, sizeof( logwriter_t ) );
+    w->fd = (int)fd;
+    w->max_delay = (uint64_t)max_delay;
+    w->max_bytes = (size_t)max_bytes;
+    w->prealloc = (size_t)prealloc;
+    if( w->prealloc && ( w->offset = logf_size( w->fd ) ) == -1 ){
+        lua_pushnil( L );
+        lua_pushstring( L, strerror( errno ) );
+        return 2;
     }
+    w->reserved = w->offset;
+    luaL_getmetatable( L, LOGWRITER_MT );
+    lua_setmetatable( L, -2 );
+    lua_newtable( L );
+    lua_setfenv( L, -2 );
     
-    return 0;
+    return 1;
 }
 
 
-static int tostring_lua( lua_State *L )
+// kernel to kernel copies
+static inline int zcresult( lua_State *L, ssize_t len )
 {
-    buf_t *b = checkudata( L );
-    
-    lua_pushlstring( L, b->mem, (size_t)b->used );
+    lua_pushinteger( L, (lua_Integer)len );
+    if( len == -1 ){
+        lua_pushstring( L, strerror( errno ) );
+        lua_pushboolean( L, errno == EAGAIN || errno == EWOULDBLOCK );
+        return 3;
+    }
     
     return 1;
 }
 
 
-static int len_lua( lua_State *L )
+static int sendfile_lua( lua_State *L )
 {
-    buf_t *b = checkudata( L );
+    lua_Integer out_fd = luaL_checkinteger( L, 1 );
+    lua_Integer in_fd = luaL_checkinteger( L, 2 );
+    lua_Integer loff = luaL_optinteger( L, 3, -1 );
+    lua_Integer len = luaL_checkinteger( L, 4 );
+    off_t off = (off_t)loff;
     
-    lua_pushinteger( L, (lua_Integer)b->used );
+    // check arguments
+    if( out_fd < 0 ){
+        return luaL_argerror( L, 1, "out_fd must be unsigned int" );
+    }
+    else if( in_fd < 0 ){
+        return luaL_argerror( L, 2, "in_fd must be unsigned int" );
+    }
+    else if( len < 0 ){
+        return luaL_argerror( L, 4, "len must be unsigned int" );
+    }
     
-    return 1;
+    // the current file offset if offset is nil or negative
+    return zcresult( L, zc_sendfile( (int)out_fd, (int)in_fd, 
+                                     loff < 0 ? NULL : &off, (size_t)len ) );
 }
 
 
-static int eq_lua( lua_State *L )
+static int splice_fd_lua( lua_State *L )
 {
-    buf_t *b = checkudata( L );
-    size_t len = 0;
-    const char *str = NULL;
+    lua_Integer out_fd = luaL_checkinteger( L, 1 );
+    lua_Integer in_fd = luaL_checkinteger( L, 2 );
+    lua_Integer len = luaL_checkinteger( L, 3 );
     
-    switch( lua_type( L, 2 ) ){
-        case LUA_TSTRING:
-            str = lua_tolstring( L, 2, &len );
-        break;
-        case LUA_TUSERDATA:
-            if( lua_getmetatable( L, 2 ) )
-            {
-                lua_pop( L, 1 );
-                if( luaL_callmeta( L, 2, "__tostring" ) ){
-                    str = lua_tolstring( L, -1, &len );
-                }
-            }
-        break;
+    // check arguments
+    if( out_fd < 0 ){
+        return luaL_argerror( L, 1, "out_fd must be unsigned int" );
+    }
+    else if( in_fd < 0 ){
+        return luaL_argerror( L, 2, "in_fd must be unsigned int" );
+    }
+    else if( len < 0 ){
+        return luaL_argerror( L, 3, "len must be unsigned int" );
     }
     
-    lua_pushboolean( L, str && len == b->used && 
-                     memcmp( str, b->mem, b->used ) == 0 );
-    return 1;
+    return zcresult( L, zc_splice( (int)out_fd, (int)in_fd, (size_t)len ) );
 }
 
 
@@ -747,6 +5021,8 @@ static int new_lua( lua_State *L )
     buf_t *b = NULL;
     int fd = -1;
     int cloexec = 0;
+    lua_Integer align = 0;
+    int direct = 0;
     
     // check arguments
     // arg#1:unit
@@ -762,22 +5038,81 @@ static int new_lua( lua_State *L )
         }
     }
     // arg#3:cloexec
-    else if( !lua_isnoneornil( L, 3 ) ){
+    if( !lua_isnoneornil( L, 3 ) ){
         luaL_checktype( L, 3, LUA_TBOOLEAN );
         cloexec = lua_toboolean( L, 3 );
     }
-
-    if( ( b = lua_newuserdata( L, sizeof( buf_t ) ) ) )
+    // arg#4:options
+    if( !lua_isnoneornil( L, 4 ) )
+    {
+        luaL_checktype( L, 4, LUA_TTABLE );
+        lua_getfield( L, 4, "align" );
+        align = luaL_optinteger( L, -1, 0 );
+        lua_getfield( L, 4, "direct" );
+        direct = lua_toboolean( L, -1 );
+        lua_pop( L, 2 );
+        // posix_memalign requires the power of 2 multiple of sizeof(void*)
+        if( align && ( align < (lua_Integer)sizeof( void* ) ||
+                       ( align & ( align - 1 ) ) ) ){
+            return luaL_argerror( L, 4, "align must be the power of 2 and "
+                                        "the multiple of the pointer size" );
+        }
+        else if( direct && !align ){
+            align = DIO_ALIGN;
+        }
+    }
+    
+    // enable the direct I/O of fd
+    if( ( !direct || fd == -1 || dio_setfd( fd, 1 ) == 0 ) &&
+        ( b = lua_newuserdata( L, sizeof( buf_t ) ) ) )
     {
         size_t unit = (size_t)lunit;
+        int rc = 0;
+        int i = 0;
+        
+        if( !align ){
+            b->mem = pnalloc( unit, char );
+        }
+        else if( ( rc = posix_memalign( &b->mem, (size_t)align, unit ) ) ){
+            b->mem = NULL;
+            errno = rc;
+        }
         
-        if( ( b->mem = pnalloc( unit, char ) ) ){
+        if( b->mem ){
             b->fd = fd;
             b->cloexec = cloexec;
             b->cur = 0;
             b->total = b->unit = unit;
             b->nalloc = 1;
             b->nmax = SIZE_MAX / unit;
+            b->u8pos = 0;
+            b->sumpos = 0;
+            b->sumalgo = BUF_SUM_NONE;
+            b->httppos = 0;
+            b->matchpos = 0;
+            b->pinned = 0;
+            b->zcsent = b->zcdone = 0;
+            b->zcend = 0;
+            b->opbusy = 0;
+            b->opend = 0;
+            b->msgoff = b->msglen = NULL;
+            b->msgtrunc = NULL;
+            b->nmsg = b->msgcap = 0;
+            b->align = (size_t)align;
+            b->direct = direct;
+            b->memlow = b->memhigh = 0;
+            b->wmlow = b->wmhigh = b->wmpending = 0;
+            b->wmabove = 0;
+            b->gen = 0;
+            for( i = 0; i < BUF_CACHE_NONE; i++ ){
+                b->cacheref[i] = LUA_NOREF;
+                b->cachegen[i] = 0;
+            }
+            buf_link( L, b );
+#if !defined(BUFFER_NO_STATS)
+            memset( &b->stats, 0, sizeof( bufstats_t ) );
+#endif
+            buf_stat_alloc( b, 0, unit );
             buf_term( b, 0 );
             // set metatable
             luaL_getmetatable( L, MODULE_MT );
@@ -794,6 +5129,31 @@ static int new_lua( lua_State *L )
 }
 
 
+static void define_mt( lua_State *L, const char *tname, 
+                       struct luaL_Reg mmethod[], struct luaL_Reg method[] )
+{
+    struct luaL_Reg *ptr = mmethod;
+    
+    // create table __metatable
+    luaL_newmetatable( L, tname );
+    // metamethods
+    while( ptr->name ){
+        lstate_fn2tbl( L, ptr->name, ptr->func );
+        ptr++;
+    }
+    // methods
+    lua_pushstring( L, "__index" );
+    lua_newtable( L );
+    ptr = method;
+    while( ptr->name ){
+        lstate_fn2tbl( L, ptr->name, ptr->func );
+        ptr++;
+    }
+    lua_rawset( L, -3 );
+    lua_pop( L, 1 );
+}
+
+
 LUALIB_API int luaopen_buffer( lua_State *L )
 {
     struct luaL_Reg mmethod[] = {
@@ -813,45 +5173,173 @@ LUALIB_API int luaopen_buffer( lua_State *L )
         { "hex", hex_lua },
         { "base64", base64std_lua },
         { "base64url", base64url_lua },
+        { "urlencode", urlencode_lua },
+        { "urlencodeform", urlencodeform_lua },
+        { "urldecode", urldecode_lua },
+        { "urldecodeform", urldecodeform_lua },
+        { "htmlescape", htmlescape_lua },
+        { "isutf8", isutf8_lua },
+        { "isutf8stream", isutf8stream_lua },
+        { "utf8len", utf8len_lua },
+        { "crc32c", crc32c_lua },
+        { "crc32cstream", crc32cstream_lua },
+        { "crc32", crc32_lua },
+        { "crc32stream", crc32stream_lua },
+        { "adler32", adler32_lua },
+        { "adler32stream", adler32stream_lua },
+        { "deflate", deflate_lua },
+        { "inflate", inflate_lua },
         { "set", set_lua },
         { "add", add_lua },
         { "insert", insert_lua },
+        { "erase", erase_lua },
+        { "replace", replace_lua },
+        { "splice", splice_lua },
         { "sub", sub_lua },
         { "substr", substr_lua },
+        { "split", split_lua },
+        { "tokens", tokens_lua },
+        { "count", count_lua },
+        { "parsehttp", parsehttp_lua },
         { "setfd", setfd_lua },
         { "cloexec", cloexec_lua },
         { "read", read_lua },
         { "readadd", readadd_lua },
         { "write", write_lua },
         { "flush", flush_lua },
+        { "broadcast", broadcast_lua },
+        { "recvmany", recvmany_lua },
+        { "sendmany", sendmany_lua },
+        { "messages", messages_lua },
+        { "message", message_lua },
         { "free", free_lua },
+        { "reclaim", reclaim_lua },
+        { "watermark", watermark_lua },
+        { "pending", pending_lua },
+        { "stats", stats_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg zmmethod[] = {
+        { "__gc", zstream_gc_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg deflater_method[] = {
+        { "update", deflater_update_lua },
+        { "flush", deflater_flush_lua },
+        { "finish", deflater_finish_lua },
+        { "reset", zstream_reset_lua },
+        { "close", zstream_close_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg inflater_method[] = {
+        { "update", inflater_update_lua },
+        { "reset", zstream_reset_lua },
+        { "close", zstream_close_lua },
         { NULL, NULL }
     };
-    struct luaL_Reg *ptr = mmethod;
     
-    // create table __metatable
-    luaL_newmetatable( L, MODULE_MT );
-    // metamethods
-    while( ptr->name ){
-        lstate_fn2tbl( L, ptr->name, ptr->func );
-        ptr++;
-    }
-    // methods
-    lua_pushstring( L, "__index" );
-    lua_newtable( L );
-    ptr = method;
-    while( ptr->name ){
-        lstate_fn2tbl( L, ptr->name, ptr->func );
-        ptr++;
+    struct luaL_Reg ring_mmethod[] = {
+        { "__gc", ring_gc_lua },
+        { "__len", ring_len_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg ring_method[] = {
+        { "push", ring_push_lua },
+        { "pop", ring_pop_lua },
+        { "readfrom", ring_readfrom_lua },
+        { "flushto", ring_flushto_lua },
+        { "len", ring_len_lua },
+        { "cap", ring_cap_lua },
+        { "handle", ring_handle_lua },
+        { "close", ring_close_lua },
+        { NULL, NULL }
+    };
+    
+    struct luaL_Reg matcher_mmethod[] = {
+        { "__gc", matcher_gc_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg matcher_method[] = {
+        { "find_all", matcher_findall_lua },
+        { "replace", matcher_replace_lua },
+        { "reset", matcher_reset_lua },
+        { NULL, NULL }
+    };
+    
+    struct luaL_Reg uring_mmethod[] = {
+        { "__gc", luring_gc_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg uring_method[] = {
+        { "read", luring_read_lua },
+        { "readadd", luring_readadd_lua },
+        { "flush", luring_flush_lua },
+        { "submit", luring_submit_lua },
+        { "complete", luring_complete_lua },
+        { "files", luring_files_lua },
+        { "register", luring_register_lua },
+        { "pending", luring_pending_lua },
+        { "backend", luring_backend_lua },
+        { "close", luring_close_lua },
+        { NULL, NULL }
+    };
+    
+    struct luaL_Reg logwriter_mmethod[] = {
+        { "__gc", logwriter_gc_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg logwriter_method[] = {
+        { "append", logwriter_append_lua },
+        { "commit", logwriter_commit_lua },
+        { "durable", logwriter_durable_lua },
+        { "pending", logwriter_pending_lua },
+        { "close", logwriter_close_lua },
+        { NULL, NULL }
+    };
+    
+    // export the api for the other C modules
+    lua_pushlightuserdata( L, (void*)&BUF_API );
+    lua_setfield( L, LUA_REGISTRYINDEX, LUA_BUFFER_API_KEY );
+#if !defined(BUFFER_NO_STATS)
+    // export the trace hook for the other C modules
+    lua_pushlightuserdata( L, (void*)(uintptr_t)buf_settrace );
+    lua_setfield( L, LUA_REGISTRYINDEX, BUFFER_SETTRACE_KEY );
+#endif
+    // list of the buffers of the lua_State
+    lua_getfield( L, LUA_REGISTRYINDEX, BUFFER_LIVE_KEY );
+    if( lua_isnil( L, -1 ) ){
+        buflist_t *list = lua_newuserdata( L, sizeof( buflist_t ) );
+        
+        list->head = NULL;
+        lua_setfield( L, LUA_REGISTRYINDEX, BUFFER_LIVE_KEY );
     }
-    lua_rawset( L, -3 );
     lua_pop( L, 1 );
     
+    define_mt( L, MODULE_MT, mmethod, method );
+    define_mt( L, DEFLATER_MT, zmmethod, deflater_method );
+    define_mt( L, INFLATER_MT, zmmethod, inflater_method );
+    define_mt( L, RING_MT, ring_mmethod, ring_method );
+    define_mt( L, MATCHER_MT, matcher_mmethod, matcher_method );
+    define_mt( L, URING_MT, uring_mmethod, uring_method );
+    define_mt( L, LOGWRITER_MT, logwriter_mmethod, logwriter_method );
+    
     // add new function
     lua_newtable( L );
     lstate_fn2tbl( L, "new", new_lua );
+    lstate_fn2tbl( L, "deflater", deflater_lua );
+    lstate_fn2tbl( L, "inflater", inflater_lua );
+    lstate_fn2tbl( L, "ring", ring_lua );
+    lstate_fn2tbl( L, "matcher", matcher_lua );
+    lstate_fn2tbl( L, "uring", luring_lua );
+    lstate_fn2tbl( L, "logwriter", logwriter_lua );
+    lstate_fn2tbl( L, "sendfile", sendfile_lua );
+    lstate_fn2tbl( L, "splice", splice_fd_lua );
+    lstate_fn2tbl( L, "workers", workers_lua );
+    lstate_fn2tbl( L, "trim", trim_lua );
+    lstate_fn2tbl( L, "pending", pending_global_lua );
+    lstate_fn2tbl( L, "stats", stats_global_lua );
+    lstate_fn2tbl( L, "profile", profile_lua );
+    lstate_fn2tbl( L, "histograms", histograms_lua );
     
     return 1;
 }
-
-
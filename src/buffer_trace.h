@@ -0,0 +1,86 @@
+/*
+ *  Copyright 2026 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  buffer_trace.h
+ *  Created by Masatoshi Teruya on 26/10/18.
+ *
+ *  trace hook of the read/write system calls for the other C modules.
+ *
+ */
+
+#ifndef BUFFER_TRACE_H
+#define BUFFER_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <lua.h>
+
+
+enum {
+    BUFFER_TRACE_READ = 0,
+    BUFFER_TRACE_WRITE
+};
+
+/*
+ * called after every read/writev of the buffers.
+ *
+ *  ctx:    the pointer passed to buffer_settrace.
+ *  buf:    address of the buffer object.
+ *  op:     BUFFER_TRACE_READ or BUFFER_TRACE_WRITE.
+ *  fd:     descriptor.
+ *  bytes:  number of bytes requested.
+ *  len:    return value of the system call.
+ *  err:    errno if len is -1, otherwise 0.
+ *  nsec:   elapsed time of the system call.
+ *
+ * the callback must not call the lua API.
+ */
+typedef void (*buffer_trace_t)( void *ctx, const void *buf, int op, int fd,
+                                size_t bytes, ssize_t len, int err,
+                                uint64_t nsec );
+
+typedef void (*buffer_settrace_t)( buffer_trace_t fn, void *ctx );
+
+// the buffer module stores the buffer_settrace_t function as a lightuserdata
+// into the registry with this key.
+#define BUFFER_SETTRACE_KEY "buffer.settrace"
+
+
+// register the trace callback. pass NULL to fn to unregister.
+// returns -1 if the buffer module has not been loaded.
+static inline int buffer_settrace( lua_State *L, buffer_trace_t fn, void *ctx )
+{
+    buffer_settrace_t settrace = NULL;
+
+    lua_getfield( L, LUA_REGISTRYINDEX, BUFFER_SETTRACE_KEY );
+    settrace = (buffer_settrace_t)(uintptr_t)lua_touserdata( L, -1 );
+    lua_pop( L, 1 );
+    if( !settrace ){
+        return -1;
+    }
+    settrace( fn, ctx );
+
+    return 0;
+}
+
+
+#endif
@@ -0,0 +1,182 @@
+/*
+ *  Copyright 2026 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  bytescan.h
+ *  Created by Masatoshi Teruya on 26/10/18.
+ *
+ *  byte and byte-set scanners for the tokenizers.
+ *
+ */
+
+#ifndef BYTESCAN_H
+#define BYTESCAN_H
+
+#include <stddef.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define BYTESCAN_SSE2   1
+#endif
+
+
+// maximum number of bytes of the set compared by SIMD
+#define BSCAN_MAXSIMD   4
+
+typedef struct {
+    // 1 = member of the set
+    unsigned char tbl[256];
+    unsigned char chars[BSCAN_MAXSIMD];
+    size_t nchar;
+} bscan_t;
+
+
+static inline void bscan_init( bscan_t *bs, const unsigned char *set,
+                               size_t len )
+{
+    size_t i = 0;
+
+    memset( bs->tbl, 0, sizeof( bs->tbl ) );
+    bs->nchar = 0;
+    for(; i < len; i++ )
+    {
+        if( !bs->tbl[set[i]] )
+        {
+            bs->tbl[set[i]] = 1;
+            if( bs->nchar < BSCAN_MAXSIMD ){
+                bs->chars[bs->nchar] = set[i];
+            }
+            bs->nchar++;
+        }
+    }
+}
+
+
+#if BYTESCAN_SSE2
+
+// returns a bitmask of the bytes in the set. nchar must be 1-BSCAN_MAXSIMD.
+static inline unsigned int bscan_mask16( const bscan_t *bs,
+                                         const unsigned char *src )
+{
+    __m128i v = _mm_loadu_si128( (const __m128i*)src );
+    __m128i m = _mm_cmpeq_epi8( v, _mm_set1_epi8( (char)bs->chars[0] ) );
+    size_t i = 1;
+
+    for(; i < bs->nchar; i++ ){
+        m = _mm_or_si128( m, _mm_cmpeq_epi8( v,
+                                _mm_set1_epi8( (char)bs->chars[i] ) ) );
+    }
+
+    return (unsigned int)_mm_movemask_epi8( m );
+}
+
+#endif
+
+
+// returns the index of the first byte that is (in = 1) or is not (in = 0)
+// a member of the set, or len if not found.
+static inline size_t bscan_span( const bscan_t *bs, const unsigned char *src,
+                                 size_t len, int in )
+{
+    size_t i = 0;
+
+#if BYTESCAN_SSE2
+    if( bs->nchar && bs->nchar <= BSCAN_MAXSIMD )
+    {
+        unsigned int flip = in ? 0 : 0xffff;
+
+        for(; i + 16 <= len; i += 16 )
+        {
+            unsigned int m = bscan_mask16( bs, src + i ) ^ flip;
+
+            if( m ){
+                return i + (size_t)__builtin_ctz( m );
+            }
+        }
+    }
+#endif
+    for(; i < len; i++ ){
+        if( bs->tbl[src[i]] == in ){
+            return i;
+        }
+    }
+
+    return len;
+}
+
+
+// returns the index of the first occurrence of delim, or len if not found.
+static inline size_t bscan_find( const unsigned char *src, size_t len,
+                                 const unsigned char *delim, size_t dlen )
+{
+    const unsigned char *cur = src;
+    const unsigned char *last = src + len;
+
+    if( !dlen || dlen > len ){
+        return len;
+    }
+    last -= dlen - 1;
+    // memchr is vectorized by the libc
+    while( ( cur = memchr( cur, *delim, (size_t)( last - cur ) ) ) ){
+        if( !memcmp( cur + 1, delim + 1, dlen - 1 ) ){
+            return (size_t)( cur - src );
+        }
+        cur++;
+    }
+
+    return len;
+}
+
+
+// returns the number of non-overlapping occurrences of delim.
+static inline size_t bscan_count( const unsigned char *src, size_t len,
+                                  const unsigned char *delim, size_t dlen )
+{
+    size_t n = 0;
+    size_t i = 0;
+
+    if( dlen == 1 )
+    {
+#if BYTESCAN_SSE2
+        __m128i c = _mm_set1_epi8( (char)*delim );
+
+        for(; i + 16 <= len; i += 16 ){
+            n += (size_t)__builtin_popcount( (unsigned int)_mm_movemask_epi8(
+                _mm_cmpeq_epi8( _mm_loadu_si128( (const __m128i*)( src + i ) ),
+                                c )
+            ) );
+        }
+#endif
+        for(; i < len; i++ ){
+            n += src[i] == *delim;
+        }
+        return n;
+    }
+
+    while( ( i += bscan_find( src + i, len - i, delim, dlen ) ) < len ){
+        i += dlen;
+        n++;
+    }
+
+    return n;
+}
+
+
+#endif
@@ -0,0 +1,415 @@
+/*
+ *  Copyright 2026 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  checksum.h
+ *  Created by Masatoshi Teruya on 26/10/18.
+ *
+ *  crc32c (castagnoli), crc32 (zlib) and adler32.
+ *
+ */
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#define CHECKSUM_X86    1
+#endif
+
+
+#define CRC32C_POLY     0x82f63b78
+#define CRC32_POLY      0xedb88320
+
+// slicing-by-8 tables
+static uint32_t CRC32C_TBL[8][256];
+static uint32_t CRC32_TBL[8][256];
+
+
+static inline void crcsum_mktbl( uint32_t tbl[8][256], uint32_t poly )
+{
+    uint32_t crc = 0;
+    int i, j;
+
+    for( i = 0; i < 256; i++ )
+    {
+        crc = (uint32_t)i;
+        for( j = 0; j < 8; j++ ){
+            crc = ( crc & 1 ) ? ( crc >> 1 ) ^ poly : crc >> 1;
+        }
+        tbl[0][i] = crc;
+    }
+    for( i = 0; i < 256; i++ )
+    {
+        crc = tbl[0][i];
+        for( j = 1; j < 8; j++ ){
+            crc = tbl[0][crc & 0xff] ^ ( crc >> 8 );
+            tbl[j][i] = crc;
+        }
+    }
+}
+
+
+// tables are created at load time
+__attribute__((constructor))
+static void crcsum_init( void )
+{
+    crcsum_mktbl( CRC32C_TBL, CRC32C_POLY );
+    crcsum_mktbl( CRC32_TBL, CRC32_POLY );
+}
+
+
+// crc must be an inverted value
+static inline uint32_t crcsum_slice8( uint32_t tbl[8][256], uint32_t crc,
+                                      const unsigned char *src, size_t len )
+{
+    uint32_t lo, hi;
+
+    // align to 8 bytes boundary
+    while( len && ( (uintptr_t)src & 7 ) ){
+        crc = tbl[0][( crc ^ *src++ ) & 0xff] ^ ( crc >> 8 );
+        len--;
+    }
+    for(; len >= 8; len -= 8, src += 8 )
+    {
+        memcpy( &lo, src, 4 );
+        memcpy( &hi, src + 4, 4 );
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        lo = __builtin_bswap32( lo );
+        hi = __builtin_bswap32( hi );
+#endif
+        lo ^= crc;
+        crc = tbl[7][lo & 0xff] ^ tbl[6][( lo >> 8 ) & 0xff] ^
+              tbl[5][( lo >> 16 ) & 0xff] ^ tbl[4][lo >> 24] ^
+              tbl[3][hi & 0xff] ^ tbl[2][( hi >> 8 ) & 0xff] ^
+              tbl[1][( hi >> 16 ) & 0xff] ^ tbl[0][hi >> 24];
+    }
+    while( len-- ){
+        crc = tbl[0][( crc ^ *src++ ) & 0xff] ^ ( crc >> 8 );
+    }
+
+    return crc;
+}
+
+
+#if CHECKSUM_X86
+
+__attribute__((target("sse4.2")))
+static inline uint32_t crc32c_sse42( uint32_t crc, const unsigned char *src,
+                                     size_t len )
+{
+    uint64_t crc64 = crc;
+    uint64_t v = 0;
+
+    while( len && ( (uintptr_t)src & 7 ) ){
+        crc64 = _mm_crc32_u8( (uint32_t)crc64, *src++ );
+        len--;
+    }
+    for(; len >= 8; len -= 8, src += 8 ){
+        memcpy( &v, src, 8 );
+        crc64 = _mm_crc32_u64( crc64, v );
+    }
+    crc = (uint32_t)crc64;
+    while( len-- ){
+        crc = _mm_crc32_u8( crc, *src++ );
+    }
+
+    return crc;
+}
+
+
+// folding by PCLMULQDQ.
+// "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction"
+// src must be larger than 64 bytes and len must be multiples of 16.
+__attribute__((target("pclmul,sse4.1")))
+static inline uint32_t crc32_pclmul( uint32_t crc, const unsigned char *src,
+                                     size_t len )
+{
+    const __m128i k1k2 = _mm_set_epi64x( 0x01c6e41596, 0x0154442bd4 );
+    const __m128i k3k4 = _mm_set_epi64x( 0x00ccaa009e, 0x01751997d0 );
+    const __m128i k5k0 = _mm_set_epi64x( 0x0000000000, 0x0163cd6124 );
+    const __m128i poly = _mm_set_epi64x( 0x01f7011641, 0x01db710641 );
+    const __m128i mask32 = _mm_setr_epi32( ~0, 0, ~0, 0 );
+    __m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_loadu_si128( (const __m128i*)( src + 0x00 ) );
+    x2 = _mm_loadu_si128( (const __m128i*)( src + 0x10 ) );
+    x3 = _mm_loadu_si128( (const __m128i*)( src + 0x20 ) );
+    x4 = _mm_loadu_si128( (const __m128i*)( src + 0x30 ) );
+    x1 = _mm_xor_si128( x1, _mm_cvtsi32_si128( (int)crc ) );
+    src += 64;
+    len -= 64;
+
+    // fold by 4
+    for(; len >= 64; len -= 64, src += 64 )
+    {
+        x5 = _mm_clmulepi64_si128( x1, k1k2, 0x00 );
+        x6 = _mm_clmulepi64_si128( x2, k1k2, 0x00 );
+        x7 = _mm_clmulepi64_si128( x3, k1k2, 0x00 );
+        x8 = _mm_clmulepi64_si128( x4, k1k2, 0x00 );
+        x1 = _mm_clmulepi64_si128( x1, k1k2, 0x11 );
+        x2 = _mm_clmulepi64_si128( x2, k1k2, 0x11 );
+        x3 = _mm_clmulepi64_si128( x3, k1k2, 0x11 );
+        x4 = _mm_clmulepi64_si128( x4, k1k2, 0x11 );
+        x1 = _mm_xor_si128( _mm_xor_si128( x1, x5 ),
+            _mm_loadu_si128( (const __m128i*)( src + 0x00 ) ) );
+        x2 = _mm_xor_si128( _mm_xor_si128( x2, x6 ),
+            _mm_loadu_si128( (const __m128i*)( src + 0x10 ) ) );
+        x3 = _mm_xor_si128( _mm_xor_si128( x3, x7 ),
+            _mm_loadu_si128( (const __m128i*)( src + 0x20 ) ) );
+        x4 = _mm_xor_si128( _mm_xor_si128( x4, x8 ),
+            _mm_loadu_si128( (const __m128i*)( src + 0x30 ) ) );
+    }
+
+    // fold into 128 bits
+    x5 = _mm_clmulepi64_si128( x1, k3k4, 0x00 );
+    x1 = _mm_clmulepi64_si128( x1, k3k4, 0x11 );
+    x1 = _mm_xor_si128( _mm_xor_si128( x1, x2 ), x5 );
+    x5 = _mm_clmulepi64_si128( x1, k3k4, 0x00 );
+    x1 = _mm_clmulepi64_si128( x1, k3k4, 0x11 );
+    x1 = _mm_xor_si128( _mm_xor_si128( x1, x3 ), x5 );
+    x5 = _mm_clmulepi64_si128( x1, k3k4, 0x00 );
+    x1 = _mm_clmulepi64_si128( x1, k3k4, 0x11 );
+    x1 = _mm_xor_si128( _mm_xor_si128( x1, x4 ), x5 );
+
+    // fold by 1
+    for(; len >= 16; len -= 16, src += 16 )
+    {
+        x2 = _mm_loadu_si128( (const __m128i*)src );
+        x5 = _mm_clmulepi64_si128( x1, k3k4, 0x00 );
+        x1 = _mm_clmulepi64_si128( x1, k3k4, 0x11 );
+        x1 = _mm_xor_si128( _mm_xor_si128( x1, x2 ), x5 );
+    }
+
+    // fold 128 bits to 64 bits
+    x2 = _mm_clmulepi64_si128( x1, k3k4, 0x10 );
+    x1 = _mm_xor_si128( _mm_srli_si128( x1, 8 ), x2 );
+    x2 = _mm_srli_si128( x1, 4 );
+    x1 = _mm_and_si128( x1, mask32 );
+    x1 = _mm_clmulepi64_si128( x1, k5k0, 0x00 );
+    x1 = _mm_xor_si128( x1, x2 );
+
+    // barrett reduction
+    x2 = _mm_and_si128( x1, mask32 );
+    x2 = _mm_clmulepi64_si128( x2, poly, 0x10 );
+    x2 = _mm_and_si128( x2, mask32 );
+    x2 = _mm_clmulepi64_si128( x2, poly, 0x00 );
+    x1 = _mm_xor_si128( x1, x2 );
+
+    return (uint32_t)_mm_extract_epi32( x1, 1 );
+}
+
+#endif
+
+
+// crc32c of castagnoli polynomial
+static inline uint32_t crc32c_update( uint32_t crc, const unsigned char *src,
+                                      size_t len )
+{
+#if CHECKSUM_X86
+    static int sse42 = -1;
+
+    if( sse42 == -1 ){
+        __builtin_cpu_init();
+        sse42 = __builtin_cpu_supports( "sse4.2" ) ? 1 : 0;
+    }
+    if( sse42 ){
+        return ~crc32c_sse42( ~crc, src, len );
+    }
+#endif
+
+    return ~crcsum_slice8( CRC32C_TBL, ~crc, src, len );
+}
+
+
+// crc32 of zlib
+static inline uint32_t crc32_update( uint32_t crc, const unsigned char *src,
+                                     size_t len )
+{
+    crc = ~crc;
+#if CHECKSUM_X86
+    static int pclmul = -1;
+
+    if( pclmul == -1 ){
+        __builtin_cpu_init();
+        pclmul = ( __builtin_cpu_supports( "pclmul" ) &&
+                   __builtin_cpu_supports( "sse4.1" ) ) ? 1 : 0;
+    }
+    if( pclmul && len >= 64 )
+    {
+        size_t n = len & ~(size_t)15;
+
+        crc = crc32_pclmul( crc, src, n );
+        src += n;
+        len -= n;
+    }
+#endif
+
+    return ~crcsum_slice8( CRC32_TBL, crc, src, len );
+}
+
+
+// adler32 of zlib
+#define ADLER32_BASE    65521
+// largest n such that 255n(n+1)/2 + (n+1)(BASE-1) <= 2^32-1
+#define ADLER32_NMAX    5552
+
+static inline uint32_t adler32_update( uint32_t adler,
+                                       const unsigned char *src, size_t len )
+{
+    uint32_t a = adler & 0xffff;
+    uint32_t b = adler >> 16;
+
+    while( len )
+    {
+        size_t n = ( len < ADLER32_NMAX ) ? len : ADLER32_NMAX;
+
+        len -= n;
+        for(; n >= 8; n -= 8, src += 8 ){
+            a += src[0]; b += a;
+            a += src[1]; b += a;
+            a += src[2]; b += a;
+            a += src[3]; b += a;
+            a += src[4]; b += a;
+            a += src[5]; b += a;
+            a += src[6]; b += a;
+            a += src[7]; b += a;
+        }
+        while( n-- ){
+            a += *src++;
+            b += a;
+        }
+        a %= ADLER32_BASE;
+        b %= ADLER32_BASE;
+    }
+
+    return b << 16 | a;
+}
+
+
+// combine checksums of the two contiguous blocks
+// returns the checksum of A+B from the checksum of A, the checksum of B
+// (calculated with the initial value) and the length of B.
+
+static inline uint32_t crcsum_gf2_times( const uint32_t mat[32], uint32_t vec )
+{
+    uint32_t sum = 0;
+
+    for(; vec; vec >>= 1, mat++ ){
+        if( vec & 1 ){
+            sum ^= *mat;
+        }
+    }
+
+    return sum;
+}
+
+
+static inline void crcsum_gf2_square( uint32_t square[32],
+                                      const uint32_t mat[32] )
+{
+    int n = 0;
+
+    for(; n < 32; n++ ){
+        square[n] = crcsum_gf2_times( mat, mat[n] );
+    }
+}
+
+
+static inline uint32_t crcsum_combine( uint32_t poly, uint32_t crc1,
+                                       uint32_t crc2, size_t len2 )
+{
+    uint32_t even[32];
+    uint32_t odd[32];
+    uint32_t row = 1;
+    int n = 1;
+
+    if( len2 == 0 ){
+        return crc1;
+    }
+
+    // operator for one zero bit
+    odd[0] = poly;
+    for(; n < 32; n++ ){
+        odd[n] = row;
+        row <<= 1;
+    }
+    // operator for two zero bits
+    crcsum_gf2_square( even, odd );
+    // operator for four zero bits
+    crcsum_gf2_square( odd, even );
+
+    // apply len2 zero bytes to crc1
+    do {
+        crcsum_gf2_square( even, odd );
+        if( len2 & 1 ){
+            crc1 = crcsum_gf2_times( even, crc1 );
+        }
+        len2 >>= 1;
+        if( !len2 ){
+            break;
+        }
+        crcsum_gf2_square( odd, even );
+        if( len2 & 1 ){
+            crc1 = crcsum_gf2_times( odd, crc1 );
+        }
+        len2 >>= 1;
+    } while( len2 );
+
+    return crc1 ^ crc2;
+}
+
+#define crc32c_concat(crc1,crc2,len2) \
+    crcsum_combine( CRC32C_POLY, crc1, crc2, len2 )
+#define crc32_concat(crc1,crc2,len2) \
+    crcsum_combine( CRC32_POLY, crc1, crc2, len2 )
+
+
+static inline uint32_t adler32_concat( uint32_t adler1, uint32_t adler2,
+                                       size_t len2 )
+{
+    uint32_t rem = (uint32_t)( len2 % ADLER32_BASE );
+    uint32_t sum1 = adler1 & 0xffff;
+    uint32_t sum2 = ( rem * sum1 ) % ADLER32_BASE;
+
+    sum1 += ( adler2 & 0xffff ) + ADLER32_BASE - 1;
+    sum2 += ( adler1 >> 16 ) + ( adler2 >> 16 ) + ADLER32_BASE - rem;
+    if( sum1 >= ADLER32_BASE ){
+        sum1 -= ADLER32_BASE;
+    }
+    if( sum1 >= ADLER32_BASE ){
+        sum1 -= ADLER32_BASE;
+    }
+    if( sum2 >= ( (uint32_t)ADLER32_BASE << 1 ) ){
+        sum2 -= ( (uint32_t)ADLER32_BASE << 1 );
+    }
+    if( sum2 >= ADLER32_BASE ){
+        sum2 -= ADLER32_BASE;
+    }
+
+    return sum2 << 16 | sum1;
+}
+
+
+#endif
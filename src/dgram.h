@@ -0,0 +1,177 @@
+/*
+ *  Copyright 2026 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  dgram.h
+ *  Created by Masatoshi Teruya on 26/10/18.
+ *
+ *  batched datagram I/O of recvmmsg and sendmmsg.
+ *
+ */
+
+#ifndef DGRAM_H
+#define DGRAM_H
+
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+
+// maximum number of datagrams of a call
+#define DGRAM_MAXMSG    1024
+// number of datagrams of a system call
+#define DGRAM_BATCH     64
+
+
+// receive up to n datagrams of up to size bytes. the datagrams are packed
+// from ptr, and their lengths are stored to lens. truncs[i] is set to 1 if
+// the datagram was longer than size bytes and truncated. ptr must have
+// n * size bytes. only the first datagram is waited for. returns the number
+// of datagrams, or -1 with errno.
+static inline int dgram_recv( int fd, char *ptr, size_t size, unsigned n,
+                              size_t *lens, unsigned char *truncs )
+{
+    unsigned total = 0;
+    size_t pos = 0;
+    unsigned i = 0;
+
+    while( total < n )
+    {
+        unsigned m = n - total > DGRAM_BATCH ? DGRAM_BATCH : n - total;
+        int rv = 0;
+#if defined(__linux__)
+        struct mmsghdr hdr[DGRAM_BATCH];
+        struct iovec iov[DGRAM_BATCH];
+
+        memset( hdr, 0, sizeof( struct mmsghdr ) * m );
+        for( i = 0; i < m; i++ ){
+            iov[i].iov_base = ptr + (size_t)( total + i ) * size;
+            iov[i].iov_len = size;
+            hdr[i].msg_hdr.msg_iov = &iov[i];
+            hdr[i].msg_hdr.msg_iovlen = 1;
+        }
+        rv = recvmmsg( fd, hdr, m, total ? MSG_DONTWAIT : MSG_WAITFORONE,
+                       NULL );
+        for( i = 0; rv > 0 && i < (unsigned)rv; i++ ){
+            lens[total + i] = hdr[i].msg_len;
+            truncs[total + i] = ( hdr[i].msg_hdr.msg_flags & MSG_TRUNC ) ?
+                                1 : 0;
+        }
+#else
+        for(; rv < (int)m; rv++ )
+        {
+            struct iovec iov = {
+                .iov_base = ptr + (size_t)( total + rv ) * size,
+                .iov_len = size
+            };
+            struct msghdr hdr = {
+                .msg_iov = &iov,
+                .msg_iovlen = 1
+            };
+            ssize_t len = recvmsg( fd, &hdr, total + rv ? MSG_DONTWAIT : 0 );
+
+            if( len == -1 ){
+                if( !rv ){
+                    rv = -1;
+                }
+                break;
+            }
+            lens[total + rv] = (size_t)len;
+            truncs[total + rv] = ( hdr.msg_flags & MSG_TRUNC ) ? 1 : 0;
+        }
+#endif
+        if( rv == -1 ){
+            // the error will be reported by the next call
+            if( total ){
+                break;
+            }
+            return -1;
+        }
+        total += (unsigned)rv;
+        if( (unsigned)rv < m ){
+            break;
+        }
+    }
+
+    // pack the datagrams
+    for( i = 0; i < total; i++ ){
+        if( pos != (size_t)i * size ){
+            memmove( ptr + pos, ptr + (size_t)i * size, lens[i] );
+        }
+        pos += lens[i];
+    }
+
+    return (int)total;
+}
+
+
+// send n datagrams of iov. returns the number of datagrams sent, or -1 with
+// errno.
+static inline int dgram_send( int fd, struct iovec *iov, unsigned n )
+{
+    unsigned total = 0;
+
+    while( total < n )
+    {
+        unsigned m = n - total > DGRAM_BATCH ? DGRAM_BATCH : n - total;
+        int rv = 0;
+#if defined(__linux__)
+        struct mmsghdr hdr[DGRAM_BATCH];
+        unsigned i = 0;
+
+        memset( hdr, 0, sizeof( struct mmsghdr ) * m );
+        for(; i < m; i++ ){
+            hdr[i].msg_hdr.msg_iov = &iov[total + i];
+            hdr[i].msg_hdr.msg_iovlen = 1;
+        }
+        rv = sendmmsg( fd, hdr, m, 0 );
+#else
+        for(; rv < (int)m; rv++ )
+        {
+            if( send( fd, iov[total + rv].iov_base, iov[total + rv].iov_len,
+                      0 ) == -1 ){
+                if( !rv ){
+                    rv = -1;
+                }
+                break;
+            }
+        }
+#endif
+        if( rv == -1 ){
+            // the error will be reported by the next call
+            if( total ){
+                break;
+            }
+            return -1;
+        }
+        total += (unsigned)rv;
+        if( (unsigned)rv < m ){
+            break;
+        }
+    }
+
+    return (int)total;
+}
+
+
+#endif
@@ -0,0 +1,129 @@
+/*
+ *  Copyright 2026 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  directio.h
+ *  Created by Masatoshi Teruya on 26/10/18.
+ *
+ *  reads and writes that bypass the page cache by O_DIRECT.
+ *
+ */
+
+#ifndef DIRECTIO_H
+#define DIRECTIO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+// default alignment of the direct I/O
+#define DIO_ALIGN   4096
+
+
+// enable or disable the direct I/O of fd.
+// returns -1 with errno on failure.
+static inline int dio_setfd( int fd, int enable )
+{
+#if defined(O_DIRECT)
+    int flg = fcntl( fd, F_GETFL );
+
+    if( flg == -1 ){
+        return -1;
+    }
+    else if( !enable == !( flg & O_DIRECT ) ){
+        return 0;
+    }
+
+    return fcntl( fd, F_SETFL, enable ? flg | O_DIRECT : flg & ~O_DIRECT );
+#elif defined(F_NOCACHE)
+    return fcntl( fd, F_NOCACHE, enable );
+#else
+    (void)fd; (void)enable;
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
+
+
+// read or write through the page cache
+static inline ssize_t dio_buffered( int fd, int wr, void *ptr, size_t len )
+{
+    ssize_t rv = 0;
+    int err = 0;
+
+    if( dio_setfd( fd, 0 ) != 0 ){
+        return -1;
+    }
+    rv = wr ? write( fd, ptr, len ) : read( fd, ptr, len );
+    err = errno;
+    dio_setfd( fd, 1 );
+    errno = err;
+
+    return rv;
+}
+
+
+// the direct I/O requires the address, the length and the file offset that
+// are aligned to the logical block size. align must be the power of 2.
+#define dio_isaligned(ptr,align)  (!( (uintptr_t)(ptr) & ( (align) - 1 ) ))
+
+
+// read up to len bytes. the unaligned part is read through the page cache.
+static inline ssize_t dio_read( int fd, void *ptr, size_t len, size_t align )
+{
+    if( dio_isaligned( ptr, align ) && dio_isaligned( len, align ) )
+    {
+        ssize_t rv = read( fd, ptr, len );
+
+        // the file offset is not aligned
+        if( rv != -1 || errno != EINVAL ){
+            return rv;
+        }
+    }
+
+    return dio_buffered( fd, 0, ptr, len );
+}
+
+
+// write up to len bytes. the aligned head is written first, and the rest
+// is written through the page cache by the next call.
+static inline ssize_t dio_write( int fd, const void *ptr, size_t len,
+                                 size_t align )
+{
+    size_t head = len & ~( align - 1 );
+
+    if( head && dio_isaligned( ptr, align ) )
+    {
+        ssize_t rv = write( fd, ptr, head );
+
+        // the file offset is not aligned
+        if( rv != -1 || errno != EINVAL ){
+            return rv;
+        }
+    }
+
+    return dio_buffered( fd, 1, (void*)ptr, len );
+}
+
+
+#endif
@@ -0,0 +1,343 @@
+/*
+ *  Copyright 2026 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  httphead.h
+ *  Created by Masatoshi Teruya on 26/10/18.
+ *
+ *  parser of the HTTP/1.x request and response head.
+ *
+ */
+
+#ifndef HTTPHEAD_H
+#define HTTPHEAD_H
+
+#include <stddef.h>
+#include <string.h>
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <nmmintrin.h>
+#define HTTPHEAD_X86    1
+#endif
+
+
+// 1 = tchar of RFC 7230
+static const unsigned char HTTPH_TCHAR[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+//  SP !  "  #  $  %  &  '  (  )  *  +  ,  -  .  /
+    0, 1, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0,
+//  0  1  2  3  4  5  6  7  8  9  :  ;  <  =  >  ?
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,
+//  @  A  B  C  D  E  F  G  H  I  J  K  L  M  N  O
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+//  P  Q  R  S  T  U  V  W  X  Y  Z  [  \  ]  ^  _
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 1,
+//  `  a  b  c  d  e  f  g  h  i  j  k  l  m  n  o
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+//  p  q  r  s  t  u  v  w  x  y  z  {  |  }  ~  DEL
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 0, 1, 0
+    // 0x80-0xff: 0
+};
+
+// ranges of the bytes that terminate the request-target: CTL, SP and DEL
+#define HTTPH_TARGET_RANGES     "\000\040\177\177"
+// ranges of the bytes that terminate the field value: CTL except HTAB, DEL
+#define HTTPH_VALUE_RANGES      "\000\010\012\037\177\177"
+
+#define httph_istarget(c)   ( (c) > 0x20 && (c) != 0x7f )
+#define httph_isvalue(c)    ( ( (c) >= 0x20 || (c) == '\t' ) && (c) != 0x7f )
+
+
+typedef struct {
+    // offsets and lengths of the start-line
+    size_t method;
+    size_t mlen;
+    size_t target;
+    size_t tlen;
+    size_t reason;
+    size_t rlen;
+    // minor version
+    int minor;
+    // 0 if request
+    int status;
+} httph_line_t;
+
+typedef struct {
+    size_t name;
+    size_t nlen;
+    size_t value;
+    size_t vlen;
+} httph_field_t;
+
+
+// returns the number of the leading empty lines
+static inline size_t httph_skipempty( const unsigned char *s, size_t len )
+{
+    size_t pos = 0;
+
+    while( pos < len && ( s[pos] == '\r' || s[pos] == '\n' ) ){
+        pos++;
+    }
+
+    return pos;
+}
+
+
+// returns the length of the head, or 0 if the head is incomplete.
+// the bytes before from have already been scanned.
+static inline size_t httph_complete( const unsigned char *s, size_t len,
+                                     size_t from )
+{
+    size_t skip = httph_skipempty( s, len );
+    const unsigned char *cur = s;
+    const unsigned char *end = s + len;
+
+    // the terminator can span the previous scan
+    from = from > 3 ? from - 3 : 0;
+    cur += from > skip ? from : skip;
+    while( cur < end && ( cur = memchr( cur, '\n', (size_t)( end - cur ) ) ) )
+    {
+        cur++;
+        if( cur < end && *cur == '\n' ){
+            return (size_t)( cur - s ) + 1;
+        }
+        else if( cur + 1 < end && cur[0] == '\r' && cur[1] == '\n' ){
+            return (size_t)( cur - s ) + 2;
+        }
+    }
+
+    return 0;
+}
+
+
+static inline size_t httph_findchar_scalar( const unsigned char *s,
+                                            size_t pos, size_t len,
+                                            int (*isok)( unsigned char ) )
+{
+    while( pos < len && isok( s[pos] ) ){
+        pos++;
+    }
+
+    return pos;
+}
+
+
+#if HTTPHEAD_X86
+
+// returns the position of the first byte that is in the ranges, or the
+// position of the last block shorter than 16 bytes.
+__attribute__((target("sse4.2")))
+static inline size_t httph_findchar_sse42( const unsigned char *s, size_t pos,
+                                           size_t len, const char *ranges,
+                                           int nranges )
+{
+    char buf[16] = { 0 };
+    __m128i r;
+
+    memcpy( buf, ranges, (size_t)nranges );
+    r = _mm_loadu_si128( (const __m128i*)buf );
+    for(; pos + 16 <= len; pos += 16 )
+    {
+        int i = _mm_cmpestri( r, nranges,
+                              _mm_loadu_si128( (const __m128i*)( s + pos ) ),
+                              16, _SIDD_LEAST_SIGNIFICANT | _SIDD_CMP_RANGES |
+                                  _SIDD_UBYTE_OPS );
+        if( i != 16 ){
+            return pos + (size_t)i;
+        }
+    }
+
+    return pos;
+}
+
+#endif
+
+
+// returns the position of the first byte that is in the ranges at or after
+// pos, or len. the scalar check must match the ranges.
+#define httph_findchar(s,pos,len,ranges,isok) \
+    httph_findchar_any( s, pos, len, ranges, sizeof( ranges ) - 1, isok )
+
+static inline size_t httph_findchar_any( const unsigned char *s, size_t pos,
+                                         size_t len, const char *ranges,
+                                         int nranges,
+                                         int (*isok)( unsigned char ) )
+{
+#if HTTPHEAD_X86
+    static int sse42 = -1;
+
+    if( sse42 == -1 ){
+        __builtin_cpu_init();
+        sse42 = __builtin_cpu_supports( "sse4.2" ) ? 1 : 0;
+    }
+    if( sse42 ){
+        pos = httph_findchar_sse42( s, pos, len, ranges, nranges );
+    }
+#else
+    (void)ranges;
+    (void)nranges;
+#endif
+
+    return httph_findchar_scalar( s, pos, len, isok );
+}
+
+
+static inline int httph_target_ok( unsigned char c )
+{
+    return httph_istarget( c );
+}
+
+static inline int httph_value_ok( unsigned char c )
+{
+    return httph_isvalue( c );
+}
+
+
+// consume the line terminator (CRLF or LF) at pos.
+// returns the position after the terminator, or 0 if not found.
+static inline size_t httph_eol( const unsigned char *s, size_t pos,
+                                size_t len )
+{
+    if( pos < len && s[pos] == '\n' ){
+        return pos + 1;
+    }
+    else if( pos + 1 < len && s[pos] == '\r' && s[pos + 1] == '\n' ){
+        return pos + 2;
+    }
+
+    return 0;
+}
+
+
+// parse "HTTP/1.x" at pos. returns the position after it, or 0.
+static inline size_t httph_version( const unsigned char *s, size_t pos,
+                                    size_t len, int *minor )
+{
+    if( len - pos < 8 || memcmp( s + pos, "HTTP/1.", 7 ) ||
+        s[pos + 7] < '0' || s[pos + 7] > '9' ){
+        return 0;
+    }
+    *minor = s[pos + 7] - '0';
+
+    return pos + 8;
+}
+
+
+// parse the start-line of the head of len bytes returned by httph_complete.
+// returns the position of the first field, or 0 if malformed.
+static inline size_t httph_parseline( const unsigned char *s, size_t len,
+                                      httph_line_t *line )
+{
+    size_t pos = httph_skipempty( s, len );
+    size_t cur = 0;
+
+    *line = (httph_line_t){ 0 };
+    // status-line
+    if( len - pos > 5 && !memcmp( s + pos, "HTTP/", 5 ) )
+    {
+        if( !( pos = httph_version( s, pos, len, &line->minor ) ) ||
+            len - pos < 4 || s[pos] != ' ' ||
+            s[pos + 1] < '1' || s[pos + 1] > '9' ||
+            s[pos + 2] < '0' || s[pos + 2] > '9' ||
+            s[pos + 3] < '0' || s[pos + 3] > '9' ){
+            return 0;
+        }
+        line->status = ( s[pos + 1] - '0' ) * 100 + ( s[pos + 2] - '0' ) * 10 +
+                       ( s[pos + 3] - '0' );
+        pos += 4;
+        // reason-phrase is optional
+        if( pos < len && s[pos] == ' ' ){
+            pos++;
+        }
+        else if( !httph_eol( s, pos, len ) ){
+            return 0;
+        }
+        line->reason = pos;
+        pos = httph_findchar( s, pos, len, HTTPH_VALUE_RANGES,
+                              httph_value_ok );
+        line->rlen = pos - line->reason;
+
+        return httph_eol( s, pos, len );
+    }
+
+    // request-line: method SP request-target SP HTTP-version
+    line->method = cur = pos;
+    while( cur < len && HTTPH_TCHAR[s[cur]] ){
+        cur++;
+    }
+    if( cur == pos || cur >= len || s[cur] != ' ' ){
+        return 0;
+    }
+    line->mlen = cur - pos;
+    line->target = pos = cur + 1;
+    cur = httph_findchar( s, pos, len, HTTPH_TARGET_RANGES, httph_target_ok );
+    if( cur == pos || cur >= len || s[cur] != ' ' ){
+        return 0;
+    }
+    line->tlen = cur - pos;
+    if( !( pos = httph_version( s, cur + 1, len, &line->minor ) ) ){
+        return 0;
+    }
+
+    return httph_eol( s, pos, len );
+}
+
+
+// parse the header field at *pos. returns 1 if parsed, 0 at the end of the
+// head, or -1 if malformed.
+static inline int httph_parsefield( const unsigned char *s, size_t len,
+                                    size_t *pos, httph_field_t *field )
+{
+    size_t cur = *pos;
+    size_t eol = 0;
+
+    if( ( eol = httph_eol( s, cur, len ) ) ){
+        *pos = eol;
+        return 0;
+    }
+
+    // field-name ":" OWS field-value OWS
+    field->name = cur;
+    while( cur < len && HTTPH_TCHAR[s[cur]] ){
+        cur++;
+    }
+    // obsolete line folding is also rejected
+    if( cur == field->name || cur >= len || s[cur] != ':' ){
+        return -1;
+    }
+    field->nlen = cur - field->name;
+    for( cur++; cur < len && ( s[cur] == ' ' || s[cur] == '\t' ); cur++ ){}
+    field->value = cur;
+    cur = httph_findchar( s, cur, len, HTTPH_VALUE_RANGES, httph_value_ok );
+    if( !( eol = httph_eol( s, cur, len ) ) ){
+        return -1;
+    }
+    while( cur > field->value &&
+           ( s[cur - 1] == ' ' || s[cur - 1] == '\t' ) ){
+        cur--;
+    }
+    field->vlen = cur - field->value;
+    *pos = eol;
+
+    return 1;
+}
+
+
+#endif
@@ -0,0 +1,130 @@
+/*
+ *  Copyright 2026 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  logfile.h
+ *  Created by Masatoshi Teruya on 26/10/18.
+ *
+ *  durable appends of the write-ahead log files.
+ *
+ */
+
+#ifndef LOGFILE_H
+#define LOGFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
+// default number of bytes to commit without waiting for the delay
+#define LOGF_MAXBYTES   ( 1024 * 1024 )
+
+
+// monotonic clock in milliseconds
+static inline uint64_t logf_msec( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+
+// write len bytes. returns the number of bytes written. errno is set if
+// the return value is less than len.
+static inline size_t logf_write( int fd, const char *ptr, size_t len )
+{
+    size_t total = 0;
+
+    while( total < len )
+    {
+        ssize_t n = write( fd, ptr + total, len - total );
+
+        if( n == -1 ){
+            if( errno == EINTR ){
+                continue;
+            }
+            break;
+        }
+        else if( n == 0 ){
+            errno = EIO;
+            break;
+        }
+        total += (size_t)n;
+    }
+
+    return total;
+}
+
+
+// flush the data written to fd to the storage.
+// returns -1 with errno on failure.
+static inline int logf_sync( int fd )
+{
+#if defined(__APPLE__) && defined(F_FULLFSYNC)
+    // fsync does not flush the cache of the drive
+    if( fcntl( fd, F_FULLFSYNC ) == 0 ){
+        return 0;
+    }
+    return fsync( fd );
+#elif defined(_POSIX_SYNCHRONIZED_IO) && _POSIX_SYNCHRONIZED_IO > 0
+    return fdatasync( fd );
+#else
+    return fsync( fd );
+#endif
+}
+
+
+// allocate the blocks of len bytes from off without changing the file
+// size, so that the appends do not allocate them.
+// returns -1 with errno on failure.
+static inline int logf_reserve( int fd, off_t off, off_t len )
+{
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+    return fallocate( fd, FALLOC_FL_KEEP_SIZE, off, len );
+#else
+    (void)fd; (void)off; (void)len;
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
+
+
+// returns the size of the file, or -1 with errno.
+static inline off_t logf_size( int fd )
+{
+    struct stat st;
+
+    if( fstat( fd, &st ) != 0 ){
+        return -1;
+    }
+
+    return st.st_size;
+}
+
+
+#endif
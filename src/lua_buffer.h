@@ -0,0 +1,303 @@
+/*
+ *  Copyright 2026 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  lua_buffer.h
+ *  Created by Masatoshi Teruya on 26/10/18.
+ *
+ *  public C API of the buffer object for the other C modules.
+ *
+ */
+
+#ifndef LUA_BUFFER_H
+#define LUA_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <lua.h>
+#include <lauxlib.h>
+#include "buffer_trace.h"
+
+
+#define LUA_BUFFER_MT       "buffer"
+// the buffer module stores the lbuf_api_t as a lightuserdata into the
+// registry with this key.
+#define LUA_BUFFER_API_KEY  "buffer.api"
+#define LUA_BUFFER_API_VERSION  2
+
+
+#if !defined(BUFFER_NO_STATS)
+// instrumentation counters
+typedef struct {
+    uint64_t realloc;       // number of realloc calls
+    uint64_t moved;         // bytes moved by insert
+    uint64_t copied;        // bytes copied out by sub/substr/tostring
+    uint64_t reads;         // number of read calls
+    uint64_t writes;        // number of writev calls
+    uint64_t again;         // number of EAGAIN or EWOULDBLOCK
+    uint64_t shortwrites;   // number of partial writes
+    uint64_t peak;          // peak of allocated bytes
+} bufstats_t;
+#endif
+
+
+// the fields before the private fields are stable, and can be read directly.
+// use the lbuf_* functions to modify the contents.
+typedef struct lua_buffer_s {
+    int fd;
+    int cloexec;
+    // write cursor of flush
+    size_t cur;
+    // buffer
+    size_t unit;
+    size_t nmax;
+    size_t nalloc;
+    // number of bytes used. mem[used] is always 0
+    size_t used;
+    // number of bytes allocated
+    size_t total;
+    void *mem;
+    // generation of the contents. incremented whenever the contents change
+    size_t gen;
+    // high watermark of the backpressure, or 0. the contents must be
+    // modified by the methods or the lbuf_* functions if it is set
+    size_t wmhigh;
+    // end of the contents referred by the asynchronous operation. the
+    // contents before opend cannot be modified
+    size_t opend;
+    // private: do not touch directly
+    // incremental scanners
+    size_t u8pos;
+    size_t sumpos;
+    uint32_t sumval;
+    int sumalgo;
+    // number of bytes scanned by parsehttp without the end of the head
+    size_t httppos;
+    // number of bytes scanned by the streaming matcher
+    size_t matchpos;
+    // number of the asynchronous operations and the registrations that
+    // refer to the memory. the memory is not reallocated while pinned
+    int pinned;
+    // zero-copy sends: number of the sends and the completions, and the end
+    // of the contents referred by the kernel
+    uint32_t zcsent;
+    uint32_t zcdone;
+    size_t zcend;
+    // whether an asynchronous operation of the uring is in flight
+    int opbusy;
+    // offsets, lengths and truncation flags of the datagrams received by
+    // recvmany
+    size_t *msgoff;
+    size_t *msglen;
+    unsigned char *msgtrunc;
+    size_t nmsg;
+    size_t msgcap;
+    // alignment of mem, or 0
+    size_t align;
+    // read and write of fd bypass the page cache
+    int direct;
+    // memory watermarks: the memory larger than memhigh bytes is shrunk to
+    // memlow bytes after a full flush
+    size_t memlow;
+    size_t memhigh;
+    // link of the buffers of the lua_State
+    struct lua_buffer_s *next;
+    struct lua_buffer_s **pprev;
+    // low watermark of the backpressure, the bytes not flushed yet counted
+    // to the module total, and whether above the high watermark
+    size_t wmlow;
+    size_t wmpending;
+    int wmabove;
+    // registry references of the strings made of the contents by tostring,
+    // hex, base64 and base64url, and the generation of the contents
+    int cacheref[4];
+    size_t cachegen[4];
+#if !defined(BUFFER_NO_STATS)
+    bufstats_t stats;
+#endif
+} buf_t;
+
+
+// functions exported by the buffer module
+typedef struct {
+    int version;
+    // reserve bytes from the position from. returns -1 with errno on failure.
+    int (*increase)( buf_t *b, size_t from, size_t bytes );
+    // set the number of bytes used to pos, and terminate the contents.
+    void (*term)( buf_t *b, size_t pos );
+    // notify that the contents after pos will be rewritten.
+    void (*touch)( buf_t *b, size_t pos );
+    // returns -1 with EBUSY if the contents after pos cannot be rewritten
+    // since the kernel refers to them.
+    int (*writable)( buf_t *b, size_t pos );
+} lbuf_api_t;
+
+
+static const lbuf_api_t *LBUF_API = NULL;
+
+// load the api of the buffer module.
+// returns -1 if the buffer module has not been loaded.
+static inline int lbuf_init( lua_State *L )
+{
+    if( !LBUF_API )
+    {
+        lua_getfield( L, LUA_REGISTRYINDEX, LUA_BUFFER_API_KEY );
+        LBUF_API = (const lbuf_api_t*)lua_touserdata( L, -1 );
+        lua_pop( L, 1 );
+        if( !LBUF_API || LBUF_API->version != LUA_BUFFER_API_VERSION ){
+            LBUF_API = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+// returns the buffer object at idx, or NULL if it is not a buffer object.
+static inline buf_t *lbuf_test( lua_State *L, int idx )
+{
+    buf_t *b = (buf_t*)lua_touserdata( L, idx );
+
+    if( b && lua_getmetatable( L, idx ) )
+    {
+        luaL_getmetatable( L, LUA_BUFFER_MT );
+        if( !lua_rawequal( L, -1, -2 ) ){
+            b = NULL;
+        }
+        lua_pop( L, 2 );
+        if( b && lbuf_init( L ) == 0 ){
+            return b;
+        }
+    }
+
+    return NULL;
+}
+
+
+// returns the buffer object at idx, or raises an error.
+static inline buf_t *lbuf_check( lua_State *L, int idx )
+{
+    buf_t *b = (buf_t*)luaL_checkudata( L, idx, LUA_BUFFER_MT );
+
+    if( lbuf_init( L ) != 0 ){
+        luaL_error( L, "incompatible buffer module" );
+    }
+    else if( !b->mem ){
+        luaL_error( L, "attempted to access already freed memory" );
+    }
+
+    return b;
+}
+
+
+// returns the contents and set its length to len.
+static inline char *lbuf_data( buf_t *b, size_t *len )
+{
+    if( len ){
+        *len = b->used;
+    }
+
+    return (char*)b->mem;
+}
+
+
+// returns the writable space of at least bytes at the tail of the contents,
+// or NULL with errno. the space is appended by lbuf_commit.
+static inline char *lbuf_reserve( buf_t *b, size_t bytes )
+{
+    // with the space for the null-terminator
+    if( bytes == SIZE_MAX ){
+        errno = ENOMEM;
+        return NULL;
+    }
+    else if( LBUF_API->increase( b, b->used, bytes + 1 ) != 0 ){
+        return NULL;
+    }
+
+    return (char*)b->mem + b->used;
+}
+
+
+// append bytes written to the space of lbuf_reserve to the contents.
+static inline void lbuf_commit( buf_t *b, size_t bytes )
+{
+    LBUF_API->term( b, b->used + bytes );
+}
+
+
+// append len bytes of src to the contents.
+// returns -1 with errno on failure.
+static inline int lbuf_append( buf_t *b, const void *src, size_t len )
+{
+    char *ptr = lbuf_reserve( b, len );
+
+    if( !ptr ){
+        return -1;
+    }
+    memcpy( ptr, src, len );
+    lbuf_commit( b, len );
+
+    return 0;
+}
+
+
+// remove bytes from the head of the contents.
+// returns -1 with errno on failure.
+static inline int lbuf_consume( buf_t *b, size_t bytes )
+{
+    if( LBUF_API->writable( b, 0 ) != 0 ){
+        return -1;
+    }
+    LBUF_API->touch( b, 0 );
+    // rewind the write cursor of flush
+    b->cur = ( b->cur > bytes ) ? b->cur - bytes : 0;
+    if( bytes >= b->used ){
+        LBUF_API->term( b, 0 );
+    }
+    else {
+        memmove( b->mem, (char*)b->mem + bytes, b->used - bytes );
+        LBUF_API->term( b, b->used - bytes );
+    }
+
+    return 0;
+}
+
+
+// discard the contents after pos.
+// returns -1 with errno on failure.
+static inline int lbuf_truncate( buf_t *b, size_t pos )
+{
+    if( pos < b->used )
+    {
+        if( LBUF_API->writable( b, pos ) != 0 ){
+            return -1;
+        }
+        LBUF_API->touch( b, pos );
+        LBUF_API->term( b, pos );
+    }
+
+    return 0;
+}
+
+
+#endif
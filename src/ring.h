@@ -0,0 +1,282 @@
+/*
+ *  Copyright 2026 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  ring.h
+ *  Created by Masatoshi Teruya on 26/10/18.
+ *
+ *  lock-free single-producer/single-consumer byte ring on shared memory.
+ *
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+
+
+#define RING_CACHELINE  64
+// "RING" and the version of the layout
+#define RING_MAGIC      0x52494e4701ULL
+
+typedef struct {
+    // RING_MAGIC while the ring is mapped
+    uint64_t magic;
+    // number of the handles that are not opened yet
+    int nhandle;
+    // written by the producer only
+    struct {
+        size_t head;
+        // last tail seen by the producer
+        size_t tail;
+    } prod __attribute__((aligned(RING_CACHELINE)));
+    // written by the consumer only
+    struct {
+        size_t tail;
+        // last head seen by the consumer
+        size_t head;
+    } cons __attribute__((aligned(RING_CACHELINE)));
+    // immutable after creation
+    size_t cap __attribute__((aligned(RING_CACHELINE)));
+    size_t mask;
+    size_t mapsize;
+    int refcnt;
+    unsigned char data[] __attribute__((aligned(RING_CACHELINE)));
+} ring_t;
+
+
+// capacity is rounded up to the power of 2.
+// returns NULL with errno on failure.
+static inline ring_t *ring_new( size_t cap )
+{
+    size_t size = 1;
+    ring_t *r = NULL;
+
+    while( size < cap ){
+        if( size > ( SIZE_MAX >> 1 ) - sizeof( ring_t ) ){
+            errno = ENOMEM;
+            return NULL;
+        }
+        size <<= 1;
+    }
+
+    r = (ring_t*)mmap( NULL, sizeof( ring_t ) + size, PROT_READ|PROT_WRITE,
+                       MAP_SHARED|MAP_ANONYMOUS, -1, 0 );
+    if( r == MAP_FAILED ){
+        return NULL;
+    }
+    // mmap returns zero-filled pages
+    r->magic = RING_MAGIC;
+    r->cap = size;
+    r->mask = size - 1;
+    r->mapsize = sizeof( ring_t ) + size;
+    r->refcnt = 1;
+
+    return r;
+}
+
+
+static inline void ring_retain( ring_t *r )
+{
+    __atomic_fetch_add( &r->refcnt, 1, __ATOMIC_RELAXED );
+}
+
+
+static inline void ring_release( ring_t *r )
+{
+    if( __atomic_sub_fetch( &r->refcnt, 1, __ATOMIC_ACQ_REL ) == 0 ){
+        r->magic = 0;
+        munmap( (void*)r, r->mapsize );
+    }
+}
+
+
+// create a handle that refers to the ring until it is opened
+static inline void ring_handle( ring_t *r )
+{
+    ring_retain( r );
+    __atomic_fetch_add( &r->nhandle, 1, __ATOMIC_RELAXED );
+}
+
+
+// open the handle. the reference of the handle is passed to the caller.
+// returns -1 with EINVAL if r is not a ring or all handles have been opened.
+static inline int ring_open( ring_t *r )
+{
+    int n = 0;
+
+    if( !r || r->magic != RING_MAGIC ){
+        errno = EINVAL;
+        return -1;
+    }
+
+    n = __atomic_load_n( &r->nhandle, __ATOMIC_RELAXED );
+    do {
+        if( n <= 0 ){
+            errno = EINVAL;
+            return -1;
+        }
+    } while( !__atomic_compare_exchange_n( &r->nhandle, &n, n - 1, 1,
+                                           __ATOMIC_ACQUIRE,
+                                           __ATOMIC_RELAXED ) );
+
+    return 0;
+}
+
+
+// number of bytes in the ring. only approximate for a third party.
+static inline size_t ring_len( ring_t *r )
+{
+    return __atomic_load_n( &r->prod.head, __ATOMIC_ACQUIRE ) -
+           __atomic_load_n( &r->cons.tail, __ATOMIC_ACQUIRE );
+}
+
+
+static inline size_t ring_segment( ring_t *r, size_t pos, size_t len,
+                                   struct iovec iov[2] )
+{
+    size_t off = pos & r->mask;
+    size_t first = r->cap - off;
+
+    if( first > len ){
+        first = len;
+    }
+    iov[0].iov_base = r->data + off;
+    iov[0].iov_len = first;
+    iov[1].iov_base = r->data;
+    iov[1].iov_len = len - first;
+
+    return len;
+}
+
+
+// producer: free space of the ring. returns the number of free bytes.
+// the position of the consumer is reloaded only if the free space is less
+// than want bytes.
+static inline size_t ring_writable( ring_t *r, size_t want,
+                                    struct iovec iov[2] )
+{
+    size_t head = r->prod.head;
+
+    if( r->cap - ( head - r->prod.tail ) < want ){
+        r->prod.tail = __atomic_load_n( &r->cons.tail, __ATOMIC_ACQUIRE );
+    }
+
+    return ring_segment( r, head, r->cap - ( head - r->prod.tail ), iov );
+}
+
+
+// producer: publish the bytes written to the space of ring_writable
+static inline void ring_commit( ring_t *r, size_t len )
+{
+    __atomic_store_n( &r->prod.head, r->prod.head + len, __ATOMIC_RELEASE );
+}
+
+
+// consumer: data of the ring. returns the number of bytes.
+// the position of the producer is reloaded only if the data is less than
+// want bytes.
+static inline size_t ring_readable( ring_t *r, size_t want,
+                                    struct iovec iov[2] )
+{
+    size_t tail = r->cons.tail;
+
+    if( r->cons.head - tail < want ){
+        r->cons.head = __atomic_load_n( &r->prod.head, __ATOMIC_ACQUIRE );
+    }
+
+    return ring_segment( r, tail, r->cons.head - tail, iov );
+}
+
+
+// consumer: release the bytes read from the data of ring_readable
+static inline void ring_consume( ring_t *r, size_t len )
+{
+    __atomic_store_n( &r->cons.tail, r->cons.tail + len, __ATOMIC_RELEASE );
+}
+
+
+// producer: copy up to len bytes into the ring.
+// returns the number of bytes copied.
+static inline size_t ring_push( ring_t *r, const void *src, size_t len )
+{
+    struct iovec iov[2];
+    size_t n = ring_writable( r, len, iov );
+
+    if( n > len ){
+        n = len;
+    }
+    if( n > iov[0].iov_len ){
+        memcpy( iov[0].iov_base, src, iov[0].iov_len );
+        memcpy( iov[1].iov_base, (const char*)src + iov[0].iov_len,
+                n - iov[0].iov_len );
+    }
+    else {
+        memcpy( iov[0].iov_base, src, n );
+    }
+    ring_commit( r, n );
+
+    return n;
+}
+
+
+// consumer: copy up to len bytes from the ring.
+// returns the number of bytes copied.
+static inline size_t ring_pop( ring_t *r, void *dest, size_t len )
+{
+    struct iovec iov[2];
+    size_t n = ring_readable( r, len, iov );
+
+    if( n > len ){
+        n = len;
+    }
+    if( n > iov[0].iov_len ){
+        memcpy( dest, iov[0].iov_base, iov[0].iov_len );
+        memcpy( (char*)dest + iov[0].iov_len, iov[1].iov_base,
+                n - iov[0].iov_len );
+    }
+    else {
+        memcpy( dest, iov[0].iov_base, n );
+    }
+    ring_consume( r, n );
+
+    return n;
+}
+
+
+// trim the segments to len bytes. returns the number of segments.
+static inline int ring_trimiov( struct iovec iov[2], size_t len )
+{
+    if( len <= iov[0].iov_len ){
+        iov[0].iov_len = len;
+        return 1;
+    }
+    iov[1].iov_len = len - iov[0].iov_len;
+
+    return 2;
+}
+
+
+#endif
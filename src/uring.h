@@ -0,0 +1,370 @@
+/*
+ *  Copyright 2026 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  uring.h
+ *  Created by Masatoshi Teruya on 26/10/18.
+ *
+ *  minimal io_uring interface over the raw system calls.
+ *
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#if defined(__linux__) && !defined(BUFFER_NO_URING) && \
+    defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#define URING_KERNEL    1
+#endif
+#endif
+
+
+enum {
+    URING_READ = 0,
+    URING_WRITE
+};
+
+typedef struct {
+    // -1 if io_uring is not available
+    int fd;
+#if URING_KERNEL
+    // submission queue
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    // number of the entries prepared but not submitted
+    unsigned nprep;
+    // completion queue
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    // mapped regions
+    void *sq_ptr;
+    size_t sq_size;
+    void *cq_ptr;
+    size_t cq_size;
+    size_t sqes_size;
+#endif
+    unsigned sq_entries;
+    unsigned cq_entries;
+} uring_t;
+
+
+#if URING_KERNEL
+
+static inline void uring_exit( uring_t *u )
+{
+    if( u->fd != -1 )
+    {
+        munmap( u->sqes, u->sqes_size );
+        if( u->cq_ptr != u->sq_ptr ){
+            munmap( u->cq_ptr, u->cq_size );
+        }
+        munmap( u->sq_ptr, u->sq_size );
+        close( u->fd );
+        u->fd = -1;
+    }
+}
+
+
+// returns -1 with errno on failure.
+static inline int uring_init( uring_t *u, unsigned entries )
+{
+    struct io_uring_params p;
+    void *ptr = NULL;
+
+    memset( u, 0, sizeof( uring_t ) );
+    memset( &p, 0, sizeof( p ) );
+    u->fd = (int)syscall( __NR_io_uring_setup, entries, &p );
+    if( u->fd == -1 ){
+        return -1;
+    }
+    // IORING_OP_READ and IORING_OP_WRITE need 5.6 or later
+    else if( !( p.features & IORING_FEAT_RW_CUR_POS ) ){
+        close( u->fd );
+        u->fd = -1;
+        errno = ENOSYS;
+        return -1;
+    }
+
+    u->sq_entries = p.sq_entries;
+    u->cq_entries = p.cq_entries;
+    u->sq_size = p.sq_off.array + p.sq_entries * sizeof( unsigned );
+    u->cq_size = p.cq_off.cqes + p.cq_entries * sizeof( struct io_uring_cqe );
+    u->sqes_size = p.sq_entries * sizeof( struct io_uring_sqe );
+    if( p.features & IORING_FEAT_SINGLE_MMAP &&
+        u->cq_size > u->sq_size ){
+        u->sq_size = u->cq_size;
+    }
+
+    u->sq_ptr = mmap( NULL, u->sq_size, PROT_READ|PROT_WRITE,
+                      MAP_SHARED|MAP_POPULATE, u->fd, IORING_OFF_SQ_RING );
+    if( u->sq_ptr == MAP_FAILED ){
+        close( u->fd );
+        u->fd = -1;
+        return -1;
+    }
+    u->cq_ptr = u->sq_ptr;
+    if( !( p.features & IORING_FEAT_SINGLE_MMAP ) )
+    {
+        u->cq_ptr = mmap( NULL, u->cq_size, PROT_READ|PROT_WRITE,
+                          MAP_SHARED|MAP_POPULATE, u->fd, IORING_OFF_CQ_RING );
+        if( u->cq_ptr == MAP_FAILED ){
+            munmap( u->sq_ptr, u->sq_size );
+            close( u->fd );
+            u->fd = -1;
+            return -1;
+        }
+    }
+    ptr = mmap( NULL, u->sqes_size, PROT_READ|PROT_WRITE,
+                MAP_SHARED|MAP_POPULATE, u->fd, IORING_OFF_SQES );
+    if( ptr == MAP_FAILED ){
+        if( u->cq_ptr != u->sq_ptr ){
+            munmap( u->cq_ptr, u->cq_size );
+        }
+        munmap( u->sq_ptr, u->sq_size );
+        close( u->fd );
+        u->fd = -1;
+        return -1;
+    }
+    u->sqes = (struct io_uring_sqe*)ptr;
+
+    u->sq_head = (unsigned*)( (char*)u->sq_ptr + p.sq_off.head );
+    u->sq_tail = (unsigned*)( (char*)u->sq_ptr + p.sq_off.tail );
+    u->sq_mask = (unsigned*)( (char*)u->sq_ptr + p.sq_off.ring_mask );
+    u->sq_array = (unsigned*)( (char*)u->sq_ptr + p.sq_off.array );
+    u->cq_head = (unsigned*)( (char*)u->cq_ptr + p.cq_off.head );
+    u->cq_tail = (unsigned*)( (char*)u->cq_ptr + p.cq_off.tail );
+    u->cq_mask = (unsigned*)( (char*)u->cq_ptr + p.cq_off.ring_mask );
+    u->cqes = (struct io_uring_cqe*)( (char*)u->cq_ptr + p.cq_off.cqes );
+
+    return 0;
+}
+
+
+// prepare the read or write of len bytes of ptr at the current file
+// position. fixed is the index of the registered file or -1, and bufidx is
+// the index of the registered buffer or -1.
+// returns -1 with EBUSY if the submission queue is full.
+static inline int uring_prep( uring_t *u, int op, int fd, int fixed,
+                              void *ptr, size_t len, int bufidx,
+                              uint64_t data )
+{
+    unsigned tail = *u->sq_tail;
+    unsigned idx = tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = u->sqes + idx;
+
+    if( tail - __atomic_load_n( u->sq_head, __ATOMIC_ACQUIRE ) >=
+        u->sq_entries ){
+        errno = EBUSY;
+        return -1;
+    }
+
+    memset( sqe, 0, sizeof( struct io_uring_sqe ) );
+    if( bufidx >= 0 ){
+        sqe->opcode = op == URING_READ ? IORING_OP_READ_FIXED :
+                                         IORING_OP_WRITE_FIXED;
+        sqe->buf_index = (uint16_t)bufidx;
+    }
+    else {
+        sqe->opcode = op == URING_READ ? IORING_OP_READ : IORING_OP_WRITE;
+    }
+    if( fixed >= 0 ){
+        sqe->fd = fixed;
+        sqe->flags = IOSQE_FIXED_FILE;
+    }
+    else {
+        sqe->fd = fd;
+    }
+    // the current file position
+    sqe->off = (uint64_t)-1;
+    sqe->addr = (uint64_t)(uintptr_t)ptr;
+    sqe->len = len > UINT32_MAX ? UINT32_MAX : (uint32_t)len;
+    sqe->user_data = data;
+    u->sq_array[idx] = idx;
+    __atomic_store_n( u->sq_tail, tail + 1, __ATOMIC_RELEASE );
+    u->nprep++;
+
+    return 0;
+}
+
+
+// prepare the cancellation of the operation of data. the completion of the
+// cancellation is posted with URING_CANCEL_DATA.
+#define URING_CANCEL_DATA   UINT64_MAX
+
+static inline int uring_cancel( uring_t *u, uint64_t data )
+{
+    unsigned tail = *u->sq_tail;
+    unsigned idx = tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = u->sqes + idx;
+
+    if( tail - __atomic_load_n( u->sq_head, __ATOMIC_ACQUIRE ) >=
+        u->sq_entries ){
+        errno = EBUSY;
+        return -1;
+    }
+
+    memset( sqe, 0, sizeof( struct io_uring_sqe ) );
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = data;
+    sqe->user_data = URING_CANCEL_DATA;
+    u->sq_array[idx] = idx;
+    __atomic_store_n( u->sq_tail, tail + 1, __ATOMIC_RELEASE );
+    u->nprep++;
+
+    return 0;
+}
+
+
+// submit the prepared entries, and wait for wait completions.
+// returns the number of the entries submitted, or -1 with errno.
+static inline int uring_submit( uring_t *u, unsigned wait )
+{
+    int rv = 0;
+
+    do {
+        rv = (int)syscall( __NR_io_uring_enter, u->fd, u->nprep, wait,
+                           wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0 );
+    } while( rv == -1 && errno == EINTR );
+    if( rv > 0 ){
+        u->nprep -= (unsigned)rv;
+    }
+
+    return rv;
+}
+
+
+// returns 1 and the result of the completion, or 0 if no completion.
+static inline int uring_reap( uring_t *u, uint64_t *data, int *res )
+{
+    unsigned head = *u->cq_head;
+    struct io_uring_cqe *cqe = NULL;
+
+    if( head == __atomic_load_n( u->cq_tail, __ATOMIC_ACQUIRE ) ){
+        return 0;
+    }
+    cqe = u->cqes + ( head & *u->cq_mask );
+    *data = cqe->user_data;
+    *res = cqe->res;
+    __atomic_store_n( u->cq_head, head + 1, __ATOMIC_RELEASE );
+
+    return 1;
+}
+
+
+// register the arg of n items by IORING_REGISTER_* opcode.
+// returns -1 with errno on failure.
+static inline int uring_register( uring_t *u, unsigned opcode, void *arg,
+                                  unsigned n )
+{
+    return (int)syscall( __NR_io_uring_register, u->fd, opcode, arg, n );
+}
+
+#define uring_register_files(u,fds,n) \
+    uring_register( u, IORING_REGISTER_FILES, fds, n )
+#define uring_unregister_files(u) \
+    uring_register( u, IORING_UNREGISTER_FILES, NULL, 0 )
+#define uring_register_buffers(u,iov,n) \
+    uring_register( u, IORING_REGISTER_BUFFERS, iov, n )
+#define uring_unregister_buffers(u) \
+    uring_register( u, IORING_UNREGISTER_BUFFERS, NULL, 0 )
+
+
+#else
+
+// io_uring is not available
+static inline int uring_init( uring_t *u, unsigned entries )
+{
+    (void)entries;
+    memset( u, 0, sizeof( uring_t ) );
+    u->fd = -1;
+    errno = ENOSYS;
+    return -1;
+}
+
+#define URING_CANCEL_DATA   UINT64_MAX
+
+static inline void uring_exit( uring_t *u )
+{
+    (void)u;
+}
+
+static inline int uring_prep( uring_t *u, int op, int fd, int fixed,
+                              void *ptr, size_t len, int bufidx,
+                              uint64_t data )
+{
+    (void)u; (void)op; (void)fd; (void)fixed; (void)ptr; (void)len;
+    (void)bufidx; (void)data;
+    errno = ENOSYS;
+    return -1;
+}
+
+static inline int uring_cancel( uring_t *u, uint64_t data )
+{
+    (void)u; (void)data;
+    errno = ENOSYS;
+    return -1;
+}
+
+static inline int uring_submit( uring_t *u, unsigned wait )
+{
+    (void)u; (void)wait;
+    errno = ENOSYS;
+    return -1;
+}
+
+static inline int uring_reap( uring_t *u, uint64_t *data, int *res )
+{
+    (void)u; (void)data; (void)res;
+    return 0;
+}
+
+static inline int uring_register( uring_t *u, unsigned opcode, void *arg,
+                                  unsigned n )
+{
+    (void)u; (void)opcode; (void)arg; (void)n;
+    errno = ENOSYS;
+    return -1;
+}
+
+#define uring_register_files(u,fds,n)   uring_register( u, 0, fds, n )
+#define uring_unregister_files(u)       uring_register( u, 0, NULL, 0 )
+#define uring_register_buffers(u,iov,n) uring_register( u, 0, iov, n )
+#define uring_unregister_buffers(u)     uring_register( u, 0, NULL, 0 )
+
+#endif
+
+
+#endif
@@ -0,0 +1,379 @@
+/*
+ *  Copyright 2026 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  urlcodec.h
+ *  Created by Masatoshi Teruya on 26/10/18.
+ *
+ *  percent-encoding (RFC 3986) and html escaping.
+ *
+ */
+
+#ifndef URLCODEC_H
+#define URLCODEC_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <string.h>
+#include <errno.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define URLCODEC_SSE2   1
+#endif
+
+
+// 1 = unreserved character of RFC 3986: ALPHA / DIGIT / "-" / "." / "_" / "~"
+static const unsigned char URLCODEC_UNRESERVED[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+//  SP !  "  #  $  %  &  '  (  )  *  +  ,  -  .  /
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0,
+//  0  1  2  3  4  5  6  7  8  9  :  ;  <  =  >  ?
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,
+//  @  A  B  C  D  E  F  G  H  I  J  K  L  M  N  O
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+//  P  Q  R  S  T  U  V  W  X  Y  Z  [  \  ]  ^  _
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1,
+//  `  a  b  c  d  e  f  g  h  i  j  k  l  m  n  o
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+//  p  q  r  s  t  u  v  w  x  y  z  {  |  }  ~  DEL
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 0
+    // 0x80-0xff: 0
+};
+
+
+#if URLCODEC_SSE2
+
+// bit-n is set if v[n] is in the lo-hi range
+static inline __m128i urlc_inrange16( __m128i v, char lo, char hi )
+{
+    __m128i d = _mm_set1_epi8( (char)( hi - lo ) );
+    __m128i t = _mm_sub_epi8( v, _mm_set1_epi8( lo ) );
+
+    return _mm_cmpeq_epi8( _mm_max_epu8( t, d ), d );
+}
+
+// returns a bitmask of the bytes that are not unreserved characters
+static inline unsigned int urlc_reserved16( const unsigned char *src )
+{
+    __m128i v = _mm_loadu_si128( (const __m128i*)src );
+    __m128i ok = _mm_or_si128(
+        urlc_inrange16( _mm_or_si128( v, _mm_set1_epi8( 0x20 ) ), 'a', 'z' ),
+        urlc_inrange16( v, '-', '.' )
+    );
+
+    ok = _mm_or_si128( ok, urlc_inrange16( v, '0', '9' ) );
+    ok = _mm_or_si128( ok, _mm_cmpeq_epi8( v, _mm_set1_epi8( '_' ) ) );
+    ok = _mm_or_si128( ok, _mm_cmpeq_epi8( v, _mm_set1_epi8( '~' ) ) );
+
+    return ~(unsigned int)_mm_movemask_epi8( ok ) & 0xffff;
+}
+
+#endif
+
+
+// returns the number of bytes required to encode
+static inline size_t urlenc_len( const unsigned char *src, size_t len,
+                                 int form )
+{
+    size_t bytes = len;
+    size_t i = 0;
+
+#if URLCODEC_SSE2
+    for(; i + 16 <= len; i += 16 )
+    {
+        unsigned int m = urlc_reserved16( src + i );
+
+        while( m ){
+            if( !form || src[i + __builtin_ctz( m )] != ' ' ){
+                bytes += 2;
+            }
+            m &= m - 1;
+        }
+    }
+#endif
+    for(; i < len; i++ ){
+        if( !URLCODEC_UNRESERVED[src[i]] && ( !form || src[i] != ' ' ) ){
+            bytes += 2;
+        }
+    }
+
+    return bytes;
+}
+
+
+// dest length must be greater than urlenc_len(src,len,form).
+// encodes from the tail to the head, so dest can be the same as src.
+static inline void urlenc( unsigned char *dest, size_t dlen,
+                           const unsigned char *src, size_t len, int form )
+{
+    static const char dec2hex[16] = "0123456789ABCDEF";
+    unsigned char c = 0;
+
+    while( len )
+    {
+#if URLCODEC_SSE2
+        if( len >= 16 )
+        {
+            unsigned int m = urlc_reserved16( src + len - 16 );
+            // number of unreserved characters at the tail
+            size_t n = m ? 15 - ( 31 - __builtin_clz( m ) ) : 16;
+
+            if( n ){
+                len -= n;
+                dlen -= n;
+                memmove( dest + dlen, src + len, n );
+                continue;
+            }
+        }
+#endif
+        c = src[--len];
+        if( URLCODEC_UNRESERVED[c] ){
+            dest[--dlen] = c;
+        }
+        else if( form && c == ' ' ){
+            dest[--dlen] = '+';
+        }
+        else {
+            dest[--dlen] = dec2hex[c & 0xf];
+            dest[--dlen] = dec2hex[c >> 4];
+            dest[--dlen] = '%';
+        }
+    }
+}
+
+
+static inline int urlc_hex2dec( unsigned char c )
+{
+    if( c >= '0' && c <= '9' ){
+        return c - '0';
+    }
+    c |= 0x20;
+    if( c >= 'a' && c <= 'f' ){
+        return c - 'a' + 10;
+    }
+
+    return -1;
+}
+
+
+// returns the position of the next '%' (or '+' if form) or len
+static inline size_t urlc_skip( const unsigned char *src, size_t i,
+                                size_t len, int form )
+{
+#if URLCODEC_SSE2
+    const __m128i pct = _mm_set1_epi8( '%' );
+    const __m128i plus = _mm_set1_epi8( form ? '+' : '%' );
+
+    for(; i + 16 <= len; i += 16 )
+    {
+        __m128i v = _mm_loadu_si128( (const __m128i*)( src + i ) );
+        unsigned int m = _mm_movemask_epi8(
+            _mm_or_si128( _mm_cmpeq_epi8( v, pct ), _mm_cmpeq_epi8( v, plus ) )
+        );
+
+        if( m ){
+            return i + __builtin_ctz( m );
+        }
+    }
+#endif
+    for(; i < len; i++ ){
+        if( src[i] == '%' || ( form && src[i] == '+' ) ){
+            break;
+        }
+    }
+
+    return i;
+}
+
+
+// returns 0 if src is a valid percent-encoded string, or -1 with EILSEQ
+static inline int urldec_verify( const unsigned char *src, size_t len )
+{
+    size_t i = urlc_skip( src, 0, len, 0 );
+
+    while( i < len )
+    {
+        if( i + 2 >= len || urlc_hex2dec( src[i + 1] ) == -1 ||
+            urlc_hex2dec( src[i + 2] ) == -1 ){
+            errno = EILSEQ;
+            return -1;
+        }
+        i = urlc_skip( src, i + 3, len, 0 );
+    }
+
+    return 0;
+}
+
+
+// dest length must be greater than len. dest can be the same as src.
+// returns the number of decoded bytes, or -1 with EILSEQ.
+static inline ssize_t urldec( unsigned char *dest, const unsigned char *src,
+                              size_t len, int form )
+{
+    size_t i = 0;
+    size_t j = 0;
+
+    while( i < len )
+    {
+        size_t n = urlc_skip( src, i, len, form ) - i;
+
+        if( n ){
+            if( dest + j != src + i ){
+                memmove( dest + j, src + i, n );
+            }
+            i += n;
+            j += n;
+        }
+        else if( src[i] == '+' ){
+            dest[j++] = ' ';
+            i++;
+        }
+        else
+        {
+            int hi, lo;
+
+            if( i + 2 >= len || ( hi = urlc_hex2dec( src[i + 1] ) ) == -1 ||
+                ( lo = urlc_hex2dec( src[i + 2] ) ) == -1 ){
+                errno = EILSEQ;
+                return -1;
+            }
+            dest[j++] = (unsigned char)( hi << 4 | lo );
+            i += 3;
+        }
+    }
+
+    return (ssize_t)j;
+}
+
+
+// html entities of & < > " '
+static inline const char *htmlc_entity( unsigned char c, size_t *len )
+{
+    switch( c ){
+        case '&':
+            *len = 5;
+            return "&amp;";
+        case '<':
+            *len = 4;
+            return "&lt;";
+        case '>':
+            *len = 4;
+            return "&gt;";
+        case '"':
+            *len = 6;
+            return "&quot;";
+        case '\'':
+            *len = 5;
+            return "&#39;";
+    }
+
+    *len = 1;
+    return NULL;
+}
+
+
+#if URLCODEC_SSE2
+
+// returns a bitmask of the bytes that must be escaped
+static inline unsigned int htmlc_special16( const unsigned char *src )
+{
+    __m128i v = _mm_loadu_si128( (const __m128i*)src );
+    __m128i m = _mm_or_si128(
+        _mm_cmpeq_epi8( v, _mm_set1_epi8( '&' ) ),
+        _mm_cmpeq_epi8( v, _mm_set1_epi8( '<' ) )
+    );
+
+    m = _mm_or_si128( m, _mm_cmpeq_epi8( v, _mm_set1_epi8( '>' ) ) );
+    m = _mm_or_si128( m, _mm_cmpeq_epi8( v, _mm_set1_epi8( '"' ) ) );
+    m = _mm_or_si128( m, _mm_cmpeq_epi8( v, _mm_set1_epi8( '\'' ) ) );
+
+    return (unsigned int)_mm_movemask_epi8( m );
+}
+
+#endif
+
+
+// returns the number of bytes required to escape
+static inline size_t htmlesc_len( const unsigned char *src, size_t len )
+{
+    size_t bytes = 0;
+    size_t n = 0;
+    size_t i = 0;
+
+#if URLCODEC_SSE2
+    for(; i + 16 <= len; i += 16 )
+    {
+        unsigned int m = htmlc_special16( src + i );
+
+        bytes += 16;
+        while( m ){
+            htmlc_entity( src[i + __builtin_ctz( m )], &n );
+            bytes += n - 1;
+            m &= m - 1;
+        }
+    }
+#endif
+    for(; i < len; i++ ){
+        htmlc_entity( src[i], &n );
+        bytes += n;
+    }
+
+    return bytes;
+}
+
+
+// dest length must be greater than htmlesc_len(src,len).
+// escapes from the tail to the head, so dest can be the same as src.
+static inline void htmlesc( unsigned char *dest, size_t dlen,
+                            const unsigned char *src, size_t len )
+{
+    const char *ent = NULL;
+    size_t n = 0;
+
+    while( len )
+    {
+#if URLCODEC_SSE2
+        if( len >= 16 )
+        {
+            unsigned int m = htmlc_special16( src + len - 16 );
+
+            n = m ? 15 - ( 31 - __builtin_clz( m ) ) : 16;
+            if( n ){
+                len -= n;
+                dlen -= n;
+                memmove( dest + dlen, src + len, n );
+                continue;
+            }
+        }
+#endif
+        len--;
+        if( ( ent = htmlc_entity( src[len], &n ) ) ){
+            dlen -= n;
+            memcpy( dest + dlen, ent, n );
+        }
+        else {
+            dest[--dlen] = src[len];
+        }
+    }
+}
+
+
+#endif
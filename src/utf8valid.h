@@ -0,0 +1,364 @@
+/*
+ *  Copyright 2026 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  utf8valid.h
+ *  Created by Masatoshi Teruya on 26/10/18.
+ *
+ *  utf-8 validation and counting.
+ *  the vectorized validator is the lookup algorithm of
+ *  "Validating UTF-8 In Less Than One Instruction Per Byte"
+ *  (John Keiser, Daniel Lemire).
+ *
+ */
+
+#ifndef UTF8VALID_H
+#define UTF8VALID_H
+
+#include <stddef.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define UTF8VALID_SSE2  1
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#include <tmmintrin.h>
+#define UTF8VALID_SSSE3 1
+#endif
+#endif
+
+
+// returns the position of the first invalid sequence, or len.
+// *incomplete is set to 1 if the sequence at the returned position is
+// truncated at the end of src.
+static inline size_t utf8_scan( const unsigned char *src, size_t len,
+                                int *incomplete )
+{
+    size_t i = 0;
+
+    *incomplete = 0;
+    while( i < len )
+    {
+        unsigned char c = src[i];
+        unsigned char lo = 0x80;
+        unsigned char hi = 0xbf;
+        size_t n = 0;
+        size_t j = 1;
+
+        if( c < 0x80 ){
+            i++;
+            continue;
+        }
+        else if( c >= 0xc2 && c <= 0xdf ){
+            n = 2;
+        }
+        else if( c >= 0xe0 && c <= 0xef ){
+            n = 3;
+            if( c == 0xe0 ){
+                lo = 0xa0;
+            }
+            else if( c == 0xed ){
+                hi = 0x9f;
+            }
+        }
+        else if( c >= 0xf0 && c <= 0xf4 ){
+            n = 4;
+            if( c == 0xf0 ){
+                lo = 0x90;
+            }
+            else if( c == 0xf4 ){
+                hi = 0x8f;
+            }
+        }
+        else {
+            return i;
+        }
+
+        // second byte has a special range
+        for(; j < n; j++ )
+        {
+            if( i + j >= len ){
+                *incomplete = 1;
+                return i;
+            }
+            else if( src[i + j] < lo || src[i + j] > hi ){
+                return i;
+            }
+            lo = 0x80;
+            hi = 0xbf;
+        }
+        i += n;
+    }
+
+    return i;
+}
+
+
+// returns the length of src without the trailing incomplete sequence
+static inline size_t utf8_boundary( const unsigned char *src, size_t len )
+{
+    size_t i = len;
+    size_t n = 0;
+
+    // find the last non-continuation byte
+    while( i > 0 && len - i < 4 )
+    {
+        unsigned char c = src[--i];
+
+        if( ( c & 0xc0 ) != 0x80 )
+        {
+            if( c >= 0xf0 && c <= 0xf4 ){
+                n = 4;
+            }
+            else if( c >= 0xe0 && c <= 0xef ){
+                n = 3;
+            }
+            else if( c >= 0xc2 && c <= 0xdf ){
+                n = 2;
+            }
+            else {
+                n = 1;
+            }
+
+            return ( len - i < n ) ? i : len;
+        }
+    }
+
+    return len;
+}
+
+
+#if UTF8VALID_SSSE3
+
+#define UTF8V_TOO_SHORT     (1<<0)
+#define UTF8V_TOO_LONG      (1<<1)
+#define UTF8V_OVERLONG_3    (1<<2)
+#define UTF8V_TOO_LARGE     (1<<3)
+#define UTF8V_SURROGATE     (1<<4)
+#define UTF8V_OVERLONG_2    (1<<5)
+#define UTF8V_TOO_LARGE_1000 (1<<6)
+#define UTF8V_OVERLONG_4    (1<<6)
+#define UTF8V_TWO_CONTS     (1<<7)
+#define UTF8V_CARRY (UTF8V_TOO_SHORT|UTF8V_TOO_LONG|UTF8V_TWO_CONTS)
+
+__attribute__((target("ssse3")))
+static inline __m128i utf8v_check16( __m128i in, __m128i prev )
+{
+    const __m128i byte_1_high = _mm_setr_epi8(
+        // 0_______ ________ <ASCII in byte 1>
+        UTF8V_TOO_LONG, UTF8V_TOO_LONG, UTF8V_TOO_LONG, UTF8V_TOO_LONG,
+        UTF8V_TOO_LONG, UTF8V_TOO_LONG, UTF8V_TOO_LONG, UTF8V_TOO_LONG,
+        // 10______ ________ <continuation in byte 1>
+        UTF8V_TWO_CONTS, UTF8V_TWO_CONTS, UTF8V_TWO_CONTS, UTF8V_TWO_CONTS,
+        // 1100____ ________ <two byte lead in byte 1>
+        UTF8V_TOO_SHORT | UTF8V_OVERLONG_2,
+        // 1101____ ________ <two byte lead in byte 1>
+        UTF8V_TOO_SHORT,
+        // 1110____ ________ <three byte lead in byte 1>
+        UTF8V_TOO_SHORT | UTF8V_OVERLONG_3 | UTF8V_SURROGATE,
+        // 1111____ ________ <four+ byte lead in byte 1>
+        UTF8V_TOO_SHORT | UTF8V_TOO_LARGE | UTF8V_TOO_LARGE_1000 |
+        UTF8V_OVERLONG_4
+    );
+    const __m128i byte_1_low = _mm_setr_epi8(
+        // ____0000 ________
+        UTF8V_CARRY | UTF8V_OVERLONG_3 | UTF8V_OVERLONG_2 | UTF8V_OVERLONG_4,
+        // ____0001 ________
+        UTF8V_CARRY | UTF8V_OVERLONG_2,
+        // ____001_ ________
+        UTF8V_CARRY,
+        UTF8V_CARRY,
+        // ____0100 ________
+        UTF8V_CARRY | UTF8V_TOO_LARGE,
+        // ____0101 ________
+        UTF8V_CARRY | UTF8V_TOO_LARGE | UTF8V_TOO_LARGE_1000,
+        // ____011_ ________
+        UTF8V_CARRY | UTF8V_TOO_LARGE | UTF8V_TOO_LARGE_1000,
+        UTF8V_CARRY | UTF8V_TOO_LARGE | UTF8V_TOO_LARGE_1000,
+        // ____1___ ________
+        UTF8V_CARRY | UTF8V_TOO_LARGE | UTF8V_TOO_LARGE_1000,
+        UTF8V_CARRY | UTF8V_TOO_LARGE | UTF8V_TOO_LARGE_1000,
+        UTF8V_CARRY | UTF8V_TOO_LARGE | UTF8V_TOO_LARGE_1000,
+        UTF8V_CARRY | UTF8V_TOO_LARGE | UTF8V_TOO_LARGE_1000,
+        UTF8V_CARRY | UTF8V_TOO_LARGE | UTF8V_TOO_LARGE_1000,
+        // ____1101 ________
+        UTF8V_CARRY | UTF8V_TOO_LARGE | UTF8V_TOO_LARGE_1000 | UTF8V_SURROGATE,
+        UTF8V_CARRY | UTF8V_TOO_LARGE | UTF8V_TOO_LARGE_1000,
+        UTF8V_CARRY | UTF8V_TOO_LARGE | UTF8V_TOO_LARGE_1000
+    );
+    const __m128i byte_2_high = _mm_setr_epi8(
+        // ________ 0_______ <ASCII in byte 2>
+        UTF8V_TOO_SHORT, UTF8V_TOO_SHORT, UTF8V_TOO_SHORT, UTF8V_TOO_SHORT,
+        UTF8V_TOO_SHORT, UTF8V_TOO_SHORT, UTF8V_TOO_SHORT, UTF8V_TOO_SHORT,
+        // ________ 1000____
+        UTF8V_TOO_LONG | UTF8V_OVERLONG_2 | UTF8V_TWO_CONTS | UTF8V_OVERLONG_3 |
+        UTF8V_TOO_LARGE_1000 | UTF8V_OVERLONG_4,
+        // ________ 1001____
+        UTF8V_TOO_LONG | UTF8V_OVERLONG_2 | UTF8V_TWO_CONTS | UTF8V_OVERLONG_3 |
+        UTF8V_TOO_LARGE,
+        // ________ 101_____
+        UTF8V_TOO_LONG | UTF8V_OVERLONG_2 | UTF8V_TWO_CONTS | UTF8V_SURROGATE |
+        UTF8V_TOO_LARGE,
+        UTF8V_TOO_LONG | UTF8V_OVERLONG_2 | UTF8V_TWO_CONTS | UTF8V_SURROGATE |
+        UTF8V_TOO_LARGE,
+        // ________ 11______
+        UTF8V_TOO_SHORT, UTF8V_TOO_SHORT, UTF8V_TOO_SHORT, UTF8V_TOO_SHORT
+    );
+    const __m128i nibble = _mm_set1_epi8( 0x0f );
+    __m128i prev1 = _mm_alignr_epi8( in, prev, 15 );
+    __m128i prev2 = _mm_alignr_epi8( in, prev, 14 );
+    __m128i prev3 = _mm_alignr_epi8( in, prev, 13 );
+    __m128i sc = _mm_and_si128(
+        _mm_and_si128(
+            _mm_shuffle_epi8( byte_1_high,
+                _mm_and_si128( _mm_srli_epi16( prev1, 4 ), nibble ) ),
+            _mm_shuffle_epi8( byte_1_low, _mm_and_si128( prev1, nibble ) )
+        ),
+        _mm_shuffle_epi8( byte_2_high,
+            _mm_and_si128( _mm_srli_epi16( in, 4 ), nibble ) )
+    );
+    // the third and fourth bytes must be continuation bytes
+    __m128i must23 = _mm_or_si128(
+        _mm_subs_epu8( prev2, _mm_set1_epi8( (char)( 0xe0 - 0x80 ) ) ),
+        _mm_subs_epu8( prev3, _mm_set1_epi8( (char)( 0xf0 - 0x80 ) ) )
+    );
+
+    return _mm_xor_si128(
+        _mm_and_si128( must23, _mm_set1_epi8( (char)0x80 ) ), sc
+    );
+}
+
+
+// returns -1 if an invalid or truncated sequence is found, and *pos is set
+// to the position of the block in which the error was detected.
+__attribute__((target("ssse3")))
+static inline int utf8v_validate_ssse3( const unsigned char *src, size_t len,
+                                        size_t *pos )
+{
+    // last three bytes must not be a lead byte of an incomplete sequence
+    const __m128i maxval = _mm_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char)0xef, (char)0xdf, (char)0xbf
+    );
+    const __m128i zero = _mm_setzero_si128();
+    __m128i prev = zero;
+    __m128i incomplete = zero;
+    __m128i err = zero;
+    __m128i in;
+    unsigned char tail[16] = { 0 };
+    size_t i = 0;
+
+    for(; i + 16 <= len; i += 16 )
+    {
+        in = _mm_loadu_si128( (const __m128i*)( src + i ) );
+        // ascii only
+        if( !_mm_movemask_epi8( in ) ){
+            err = incomplete;
+            incomplete = zero;
+        }
+        else {
+            err = utf8v_check16( in, prev );
+            incomplete = _mm_subs_epu8( in, maxval );
+        }
+        if( _mm_movemask_epi8( _mm_cmpeq_epi8( err, zero ) ) != 0xffff ){
+            *pos = i;
+            return -1;
+        }
+        prev = in;
+    }
+
+    // zero padding makes a truncated sequence to an error
+    memcpy( tail, src + i, len - i );
+    in = _mm_loadu_si128( (const __m128i*)tail );
+    err = utf8v_check16( in, prev );
+    if( _mm_movemask_epi8( _mm_cmpeq_epi8( err, zero ) ) != 0xffff ){
+        *pos = i;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static inline int utf8v_has_ssse3( void )
+{
+    static int supported = -1;
+
+    if( supported == -1 ){
+        __builtin_cpu_init();
+        supported = __builtin_cpu_supports( "ssse3" ) ? 1 : 0;
+    }
+
+    return supported;
+}
+
+#endif
+
+
+// returns the position of the first invalid or truncated sequence, or len
+static inline size_t utf8_validate( const unsigned char *src, size_t len )
+{
+    size_t i = 0;
+    int incomplete = 0;
+
+#if UTF8VALID_SSSE3
+    if( len >= 16 && utf8v_has_ssse3() )
+    {
+        if( utf8v_validate_ssse3( src, len, &i ) == 0 ){
+            return len;
+        }
+        // the error may be caused by the sequence that started in the
+        // previous block, rewind to the lead byte of that block.
+        i = ( i >= 16 ) ? i - 16 : 0;
+        while( i > 0 && ( src[i] & 0xc0 ) == 0x80 ){
+            i--;
+        }
+    }
+#endif
+
+    return i + utf8_scan( src + i, len - i, &incomplete );
+}
+
+
+// returns the number of characters of valid utf-8 string
+static inline size_t utf8_count( const unsigned char *src, size_t len )
+{
+    size_t n = 0;
+    size_t i = 0;
+
+#if UTF8VALID_SSE2
+    // count the bytes that are not continuation bytes
+    const __m128i cont = _mm_set1_epi8( (char)0xbf );
+
+    for(; i + 16 <= len; i += 16 ){
+        __m128i in = _mm_loadu_si128( (const __m128i*)( src + i ) );
+        n += __builtin_popcount( _mm_movemask_epi8(
+            _mm_cmpgt_epi8( in, cont )
+        ) );
+    }
+#endif
+    for(; i < len; i++ ){
+        n += ( src[i] & 0xc0 ) != 0x80;
+    }
+
+    return n;
+}
+
+
+#endif
@@ -0,0 +1,256 @@
+/*
+ *  Copyright 2026 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  workpool.h
+ *  Created by Masatoshi Teruya on 26/10/18.
+ *
+ *  process-wide worker threads that run the chunks of a job in parallel.
+ *
+ */
+
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+
+
+// default minimum number of bytes to run in parallel
+#define WPOOL_THRESHOLD     ( 4 * 1024 * 1024 )
+// minimum number of bytes of a chunk
+#define WPOOL_MINCHUNK      ( 256 * 1024 )
+// maximum number of worker threads
+#define WPOOL_MAXTHREAD     64
+
+// fn is called with the index of the chunk
+typedef void (*wpool_fn)( void *arg, size_t idx );
+
+typedef struct {
+    // held by the thread that runs a job
+    pthread_mutex_t run;
+    // protects the fields below
+    pthread_mutex_t mutex;
+    pthread_cond_t wakeup;
+    pthread_cond_t finish;
+    // configuration
+    int nconf;
+    size_t threshold;
+    // worker threads
+    int stop;
+    int nthread;
+    pthread_t threads[WPOOL_MAXTHREAD];
+    // job
+    wpool_fn fn;
+    void *arg;
+    size_t nchunk;
+    size_t next;
+    size_t done;
+} wpool_t;
+
+static wpool_t WPOOL = {
+    .run = PTHREAD_MUTEX_INITIALIZER,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .wakeup = PTHREAD_COND_INITIALIZER,
+    .finish = PTHREAD_COND_INITIALIZER,
+    // -1: number of online processors - 1
+    .nconf = -1,
+    .threshold = WPOOL_THRESHOLD
+};
+
+// the configuration is written under WPOOL.run, and read without the lock
+#define wpool_nconf()       __atomic_load_n( &WPOOL.nconf, __ATOMIC_RELAXED )
+#define wpool_threshold()   __atomic_load_n( &WPOOL.threshold, \
+                                             __ATOMIC_RELAXED )
+
+
+// run the remaining chunks. WPOOL.mutex must be locked.
+static inline void wpool_drain( void )
+{
+    while( WPOOL.next < WPOOL.nchunk )
+    {
+        size_t idx = WPOOL.next++;
+
+        pthread_mutex_unlock( &WPOOL.mutex );
+        WPOOL.fn( WPOOL.arg, idx );
+        pthread_mutex_lock( &WPOOL.mutex );
+        if( ++WPOOL.done == WPOOL.nchunk ){
+            pthread_cond_signal( &WPOOL.finish );
+        }
+    }
+}
+
+
+static void *wpool_worker( void *arg )
+{
+    (void)arg;
+    pthread_mutex_lock( &WPOOL.mutex );
+    while( !WPOOL.stop )
+    {
+        if( WPOOL.next < WPOOL.nchunk ){
+            wpool_drain();
+        }
+        else {
+            pthread_cond_wait( &WPOOL.wakeup, &WPOOL.mutex );
+        }
+    }
+    pthread_mutex_unlock( &WPOOL.mutex );
+
+    return NULL;
+}
+
+
+// stop all worker threads. WPOOL.run must be locked.
+static inline void wpool_stop( void )
+{
+    int i = 0;
+
+    pthread_mutex_lock( &WPOOL.mutex );
+    WPOOL.stop = 1;
+    pthread_cond_broadcast( &WPOOL.wakeup );
+    pthread_mutex_unlock( &WPOOL.mutex );
+    for(; i < WPOOL.nthread; i++ ){
+        pthread_join( WPOOL.threads[i], NULL );
+    }
+    WPOOL.nthread = 0;
+    WPOOL.stop = 0;
+}
+
+
+// start the configured number of worker threads. WPOOL.run must be locked.
+static inline void wpool_start( void )
+{
+    int n = WPOOL.nconf;
+    sigset_t all, old;
+
+    if( n < 0 ){
+        long nproc = sysconf( _SC_NPROCESSORS_ONLN );
+
+        n = nproc > 1 ? (int)nproc - 1 : 0;
+    }
+    if( n > WPOOL_MAXTHREAD ){
+        n = WPOOL_MAXTHREAD;
+    }
+
+    // signals should be delivered to the threads of the application
+    sigfillset( &all );
+    pthread_sigmask( SIG_SETMASK, &all, &old );
+    for(; WPOOL.nthread < n; WPOOL.nthread++ ){
+        if( pthread_create( &WPOOL.threads[WPOOL.nthread], NULL,
+                            wpool_worker, NULL ) != 0 ){
+            break;
+        }
+    }
+    pthread_sigmask( SIG_SETMASK, &old, NULL );
+    // do not retry
+    __atomic_store_n( &WPOOL.nconf, WPOOL.nthread, __ATOMIC_RELAXED );
+}
+
+
+// set the number of worker threads (n < 0: automatic) and the threshold.
+static inline void wpool_config( int n, size_t threshold )
+{
+    pthread_mutex_lock( &WPOOL.run );
+    if( n != WPOOL.nconf ){
+        wpool_stop();
+        __atomic_store_n( &WPOOL.nconf, n, __ATOMIC_RELAXED );
+    }
+    __atomic_store_n( &WPOOL.threshold, threshold, __ATOMIC_RELAXED );
+    pthread_mutex_unlock( &WPOOL.run );
+}
+
+
+// returns the number of chunks of len bytes. the size of chunk is aligned
+// to the multiple of align.
+static inline size_t wpool_split( size_t len, size_t align, size_t *chunk )
+{
+    int nconf = wpool_nconf();
+    size_t nthread = nconf < 0 ? WPOOL_MAXTHREAD : (size_t)nconf;
+    size_t size = 0;
+
+    if( len < wpool_threshold() || !nthread ){
+        *chunk = len;
+        return 1;
+    }
+
+    // 4 chunks per thread to balance the load
+    size = len / ( ( nthread + 1 ) * 4 );
+    if( size < WPOOL_MINCHUNK ){
+        size = WPOOL_MINCHUNK;
+    }
+    size -= size % align;
+    *chunk = size;
+
+    return len / size + ( len % size ? 1 : 0 );
+}
+
+
+// run fn for each chunk in parallel, and wait for completion.
+// the chunks are run serially if the pool is used by the other thread.
+static inline void wpool_run( wpool_fn fn, void *arg, size_t nchunk )
+{
+    size_t i = 0;
+
+    if( nchunk > 1 && pthread_mutex_trylock( &WPOOL.run ) == 0 )
+    {
+        if( !WPOOL.nthread ){
+            wpool_start();
+        }
+        if( WPOOL.nthread )
+        {
+            pthread_mutex_lock( &WPOOL.mutex );
+            WPOOL.fn = fn;
+            WPOOL.arg = arg;
+            WPOOL.nchunk = nchunk;
+            WPOOL.next = 0;
+            WPOOL.done = 0;
+            pthread_cond_broadcast( &WPOOL.wakeup );
+            wpool_drain();
+            while( WPOOL.done < WPOOL.nchunk ){
+                pthread_cond_wait( &WPOOL.finish, &WPOOL.mutex );
+            }
+            WPOOL.nchunk = WPOOL.next = 0;
+            pthread_mutex_unlock( &WPOOL.mutex );
+            pthread_mutex_unlock( &WPOOL.run );
+            return;
+        }
+        pthread_mutex_unlock( &WPOOL.run );
+    }
+
+    for(; i < nchunk; i++ ){
+        fn( arg, i );
+    }
+}
+
+
+// the threads must be stopped before the module is unloaded
+__attribute__((destructor))
+static void wpool_fini( void )
+{
+    pthread_mutex_lock( &WPOOL.run );
+    wpool_stop();
+    pthread_mutex_unlock( &WPOOL.run );
+}
+
+
+#endif
@@ -0,0 +1,278 @@
+/*
+ *  Copyright 2026 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  zerocopy.h
+ *  Created by Masatoshi Teruya on 26/10/18.
+ *
+ *  zero-copy transmission: MSG_ZEROCOPY, sendfile and splice.
+ *
+ */
+
+#ifndef ZEROCOPY_H
+#define ZEROCOPY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#include <linux/errqueue.h>
+#endif
+
+
+#if defined(__linux__) && defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY)
+#define ZEROCOPY_MSG    1
+#endif
+
+// payloads smaller than this are copied, since the notification costs more
+// than the copy
+#define ZC_MINLEN   ( 16 * 1024 )
+
+
+#if ZEROCOPY_MSG
+
+// send with MSG_ZEROCOPY. the pages of ptr are referred by the kernel until
+// the notification is reaped by zc_reap.
+// returns -1 with ENOTSUP if the socket does not support zero-copy.
+static inline ssize_t zc_send( int fd, const void *ptr, size_t len )
+{
+    int on = 1;
+    ssize_t rv = 0;
+
+    // the option is required only once, but it is cheaper than tracking
+    // the descriptors
+    if( setsockopt( fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof( on ) ) != 0 ){
+        errno = ENOTSUP;
+        return -1;
+    }
+    rv = send( fd, ptr, len, MSG_ZEROCOPY );
+    if( rv == -1 && ( errno == EOPNOTSUPP || errno == ENOBUFS ) ){
+        errno = ENOTSUP;
+    }
+
+    return rv;
+}
+
+
+// reap the notifications from the error queue of the socket.
+// *done is set to the number of the completed sends, that is the end of
+// the range of the notification. returns -1 with errno on failure.
+static inline int zc_reap( int fd, uint32_t *done )
+{
+    char ctrl[CMSG_SPACE( sizeof( struct sock_extended_err ) ) + 64];
+    struct msghdr msg;
+    struct cmsghdr *cm = NULL;
+
+    while( 1 )
+    {
+        memset( &msg, 0, sizeof( msg ) );
+        msg.msg_control = ctrl;
+        msg.msg_controllen = sizeof( ctrl );
+        if( recvmsg( fd, &msg, MSG_ERRQUEUE|MSG_DONTWAIT ) == -1 ){
+            return ( errno == EAGAIN || errno == EWOULDBLOCK ) ? 0 : -1;
+        }
+        for( cm = CMSG_FIRSTHDR( &msg ); cm; cm = CMSG_NXTHDR( &msg, cm ) )
+        {
+            struct sock_extended_err ee;
+
+            if( !( ( cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR ) ||
+                   ( cm->cmsg_level == SOL_IPV6 &&
+                     cm->cmsg_type == IPV6_RECVERR ) ) ){
+                continue;
+            }
+            memcpy( &ee, CMSG_DATA( cm ), sizeof( ee ) );
+            // ee_info-ee_data: range of the completed sends
+            if( ee.ee_origin == SO_EE_ORIGIN_ZEROCOPY && ee.ee_errno == 0 &&
+                (int32_t)( ee.ee_data + 1 - *done ) > 0 ){
+                *done = ee.ee_data + 1;
+            }
+        }
+    }
+}
+
+#else
+
+static inline ssize_t zc_send( int fd, const void *ptr, size_t len )
+{
+    (void)fd; (void)ptr; (void)len;
+    errno = ENOTSUP;
+    return -1;
+}
+
+static inline int zc_reap( int fd, uint32_t *done )
+{
+    (void)fd; (void)done;
+    return 0;
+}
+
+#endif
+
+
+// copy len bytes from in_fd at *off (the current file offset if off is
+// NULL) to out_fd in the kernel. returns the number of bytes copied, or -1.
+static inline ssize_t zc_sendfile( int out_fd, int in_fd, off_t *off,
+                                   size_t len )
+{
+#if defined(__linux__)
+    return sendfile( out_fd, in_fd, off, len );
+#else
+    (void)out_fd; (void)in_fd; (void)off; (void)len;
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
+
+
+// move len bytes from in_fd to out_fd through the pipe buffer. one of the
+// descriptors must be a pipe.
+static inline ssize_t zc_splice( int out_fd, int in_fd, size_t len )
+{
+#if defined(__linux__) && defined(SPLICE_F_MOVE)
+    return splice( in_fd, NULL, out_fd, NULL, len,
+                   SPLICE_F_MOVE|SPLICE_F_NONBLOCK );
+#else
+    (void)out_fd; (void)in_fd; (void)len;
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
+
+
+// fan-out of the same contents to many descriptors. the contents are
+// copied once into a pipe, and duplicated to each descriptor by tee and
+// splice. vmsplice is not used since the pages of the buffer would be
+// referred by the sockets after the return.
+typedef struct {
+    // pipe of the contents
+    int src[2];
+    // pipe of the duplicated contents for a descriptor
+    int dup[2];
+    // discards the contents that were not sent
+    int null;
+    size_t len;
+} zc_fanout_t;
+
+
+static inline void zc_fanout_close( zc_fanout_t *f )
+{
+    int *fds[] = { &f->src[0], &f->src[1], &f->dup[0], &f->dup[1], &f->null };
+    size_t i = 0;
+
+    for(; i < sizeof( fds ) / sizeof( int* ); i++ ){
+        if( *fds[i] != -1 ){
+            close( *fds[i] );
+            *fds[i] = -1;
+        }
+    }
+    f->len = 0;
+}
+
+
+#if defined(__linux__) && defined(SPLICE_F_MOVE) && defined(F_SETPIPE_SZ)
+
+// returns -1 if the contents cannot be stored in a pipe
+static inline int zc_fanout_open( zc_fanout_t *f, const void *ptr, size_t len )
+{
+    f->src[0] = f->src[1] = f->dup[0] = f->dup[1] = f->null = -1;
+    f->len = len;
+    if( len > INT_MAX ||
+        pipe2( f->src, O_NONBLOCK|O_CLOEXEC ) != 0 ||
+        pipe2( f->dup, O_NONBLOCK|O_CLOEXEC ) != 0 ||
+        ( f->null = open( "/dev/null", O_WRONLY|O_CLOEXEC ) ) == -1 ||
+        // the capacity is limited by /proc/sys/fs/pipe-max-size
+        fcntl( f->src[1], F_SETPIPE_SZ, (int)len ) < (int)len ||
+        fcntl( f->dup[1], F_SETPIPE_SZ, (int)len ) < (int)len ||
+        write( f->src[1], ptr, len ) != (ssize_t)len ){
+        zc_fanout_close( f );
+        return -1;
+    }
+
+    return 0;
+}
+
+
+// send the contents to fd. returns the number of bytes sent, or -1 with
+// errno. EINVAL means that fd does not support splice.
+static inline ssize_t zc_fanout_send( zc_fanout_t *f, int fd )
+{
+    ssize_t rv = tee( f->src[0], f->dup[1], f->len, SPLICE_F_NONBLOCK );
+    size_t remain = f->len;
+    int err = 0;
+
+    if( rv != (ssize_t)f->len ){
+        // the pipes cannot be reused
+        zc_fanout_close( f );
+        errno = EINVAL;
+        return -1;
+    }
+
+    rv = splice( f->dup[0], NULL, fd, NULL, f->len,
+                 SPLICE_F_MOVE|SPLICE_F_NONBLOCK );
+    err = errno;
+    if( rv > 0 ){
+        remain -= (size_t)rv;
+    }
+    // discard the rest
+    while( remain )
+    {
+        ssize_t n = splice( f->dup[0], NULL, f->null, NULL, remain,
+                            SPLICE_F_MOVE|SPLICE_F_NONBLOCK );
+
+        if( n <= 0 ){
+            zc_fanout_close( f );
+            break;
+        }
+        remain -= (size_t)n;
+    }
+    errno = err;
+
+    return rv;
+}
+
+#else
+
+static inline int zc_fanout_open( zc_fanout_t *f, const void *ptr, size_t len )
+{
+    (void)ptr; (void)len;
+    f->src[0] = f->src[1] = f->dup[0] = f->dup[1] = f->null = -1;
+    f->len = 0;
+    errno = ENOTSUP;
+    return -1;
+}
+
+static inline ssize_t zc_fanout_send( zc_fanout_t *f, int fd )
+{
+    (void)f; (void)fd;
+    errno = EINVAL;
+    return -1;
+}
+
+#endif
+
+
+#endif
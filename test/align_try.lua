@@ -0,0 +1,30 @@
+local buffer = require('buffer');
+local b = ifNil( buffer.new( 10, nil, nil, { align = 64 } ) );
+local i;
+
+-- the contents are kept across growth
+for i = 1, 100 do
+    ifNotNil( b:add( 'abcdefghij' ) );
+end
+ifNotEqual( #b, 1000 );
+ifNotEqual( b:sub( 991 ), 'abcdefghij' );
+ifNotTrue( b:total() > 1000 );
+ifNotNil( b:insert( 1, 'xyz' ) );
+ifNotEqual( b:sub( 1, 13 ), 'xyzabcdefghij' );
+b:free();
+
+-- direct I/O mode without descriptor
+b = ifNil( buffer.new( 100, nil, nil, { direct = true } ) );
+ifNotNil( b:set( 'hello' ) );
+ifNotEqual( tostring( b ), 'hello' );
+
+-- cloexec with descriptor
+b = ifNil( buffer.new( 8, 9999, true ) );
+ifNotTrue( b:cloexec() );
+b:cloexec( false );
+
+-- invalid options
+ifTrue( pcall( buffer.new, 8, nil, nil, 1 ) );
+ifTrue( pcall( buffer.new, 8, nil, nil, { align = 3 } ) );
+ifTrue( pcall( buffer.new, 8, nil, nil, { align = 2 } ) );
+ifTrue( pcall( buffer.new, 8, nil, nil, { align = 'a' } ) );
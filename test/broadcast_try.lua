@@ -0,0 +1,42 @@
+local buffer = require('buffer');
+local b = ifNil( buffer.new( 8 ) );
+local offs = {};
+local remain, errs;
+
+-- descriptors that are not opened
+ifNotNil( b:set( string.rep( 'x', 65536 ) ) );
+remain, errs = b:broadcast( { 9999, 9998 }, offs );
+ifNotEqual( remain, 0 );
+ifNil( errs );
+ifNil( errs[1] );
+ifNil( errs[2] );
+ifNotEqual( offs[1], -1 );
+ifNotEqual( offs[2], -1 );
+-- the contents are not modified
+ifNotEqual( #b, 65536 );
+ifNotEqual( b:sub( 1, 1 ), 'x' );
+
+-- failed descriptors are skipped
+remain, errs = b:broadcast( { 9999, 9998 }, offs );
+ifNotEqual( remain, 0 );
+ifNotNil( errs );
+
+-- completed descriptors are skipped
+remain, errs = b:broadcast( { 9999 }, { 65536 } );
+ifNotEqual( remain, 0 );
+ifNotNil( errs );
+
+-- without offsets
+ifNotNil( b:set( 'hello' ) );
+remain, errs = b:broadcast( { 9999 } );
+ifNotEqual( remain, 0 );
+ifNil( errs );
+remain, errs = b:broadcast( {} );
+ifNotEqual( remain, 0 );
+ifNotNil( errs );
+
+-- invalid arguments
+ifTrue( pcall( b.broadcast, b ) );
+ifTrue( pcall( b.broadcast, b, { -1 } ) );
+ifTrue( pcall( b.broadcast, b, { 'a' } ) );
+ifTrue( pcall( b.broadcast, b, { 1 }, 1 ) );
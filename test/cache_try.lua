@@ -0,0 +1,93 @@
+local buffer = require('buffer');
+local b = ifNil( buffer.new( 16 ) );
+local c = ifNil( buffer.new( 16 ) );
+local eq = getmetatable( b ).__eq;
+local s1, s2, h, e, u;
+
+-- same string while the contents are unchanged
+ifNotNil( b:set( 'hello world!' ) );
+s1 = tostring( b );
+s2 = tostring( b );
+ifNotEqual( s1, 'hello world!' );
+ifNotEqual( tostring( b ), s2 );
+h = b:hex();
+ifNotEqual( b:hex(), h );
+ifNotEqual( b:hex(), '68656c6c6f20776f726c6421' );
+e = b:base64();
+ifNotEqual( b:base64(), e );
+ifNotEqual( b:base64(), 'aGVsbG8gd29ybGQh' );
+u = b:base64url();
+ifNotEqual( b:base64url(), u );
+ifNotEqual( b:base64url(), 'aGVsbG8gd29ybGQh' );
+ifNotTrue( eq( b, 'hello world!' ) );
+ifTrue( eq( b, 'hello world?' ) );
+
+-- every modification invalidates the strings
+ifNotNil( b:add( '?' ) );
+ifNotEqual( tostring( b ), 'hello world!?' );
+ifNotEqual( tostring( b ), 'hello world!?' );
+ifNotEqual( b:hex(), '68656c6c6f20776f726c64213f' );
+ifNotEqual( b:base64(), 'aGVsbG8gd29ybGQhPw==' );
+ifNotEqual( b:base64url(), 'aGVsbG8gd29ybGQhPw' );
+ifNotTrue( eq( b, 'hello world!?' ) );
+ifNotNil( b:insert( 1, '>' ) );
+ifNotEqual( tostring( b ), '>hello world!?' );
+b:erase( 7 );
+ifNotEqual( tostring( b ), '>hello' );
+ifNotEqual( b:hex(), '3e68656c6c6f' );
+ifNotNil( b:set( 'hi' ) );
+ifNotEqual( tostring( b ), 'hi' );
+ifNotEqual( b:base64(), 'aGk=' );
+ifNotNil( b:set( '' ) );
+ifNotEqual( tostring( b ), '' );
+ifNotEqual( b:hex(), '' );
+
+-- the stale strings are released when the contents are replaced
+do
+    local str = string.rep( 'cached', 100 );
+    local function retained()
+        for _, v in pairs( debug.getregistry() ) do
+            if v == str then
+                return true;
+            end
+        end
+        return false;
+    end
+
+    ifNotNil( b:set( str ) );
+    tostring( b );
+    tostring( b );
+    ifNotTrue( retained() );
+    ifNotNil( b:set( 'x' ) );
+    ifTrue( retained() );
+    -- by buffer.trim
+    ifNotNil( b:set( str ) );
+    b:hex();
+    tostring( b );
+    tostring( b );
+    b:erase( 1 );
+    buffer.trim();
+    ifTrue( retained() );
+    ifNotNil( b:set( '' ) );
+end
+
+-- compare the buffers
+ifNotNil( b:set( 'abc' ) );
+ifNotNil( c:set( 'abc' ) );
+ifNotTrue( b == c );
+ifNotTrue( b == b );
+ifNotTrue( eq( b, c ) );
+ifNotNil( c:add( 'd' ) );
+ifTrue( b == c );
+ifNotNil( b:add( 'e' ) );
+ifTrue( b == c );
+ifNotEqual( tostring( b ), 'abce' );
+ifNotEqual( tostring( c ), 'abcd' );
+
+-- freed buffer
+c:free();
+ifTrue( b == c );
+ifNotNil( b:set( 'x' ) );
+ifNotEqual( tostring( b ), 'x' );
+b:free();
+ifTrue( pcall( tostring, b ) );
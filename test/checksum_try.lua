@@ -0,0 +1,30 @@
+local buffer = require('buffer');
+local str = '123456789';
+local b = ifNil( buffer.new( 10 ) );
+
+ifNotNil( b:set( str ) );
+ifNotEqual( b:crc32c(), 0xe3069283 );
+ifNotEqual( b:crc32(), 0xcbf43926 );
+ifNotEqual( b:adler32(), 0x091e01de );
+
+-- range and seed
+ifNotEqual( b:crc32c( 5, -1, b:crc32c( 1, 4 ) ), 0xe3069283 );
+ifNotEqual( b:crc32( 5, nil, b:crc32( 1, 4 ) ), 0xcbf43926 );
+ifNotEqual( b:adler32( 5, nil, b:adler32( 1, 4 ) ), 0x091e01de );
+ifNotEqual( b:crc32c( 10 ), 0 );
+
+-- large contents
+ifNotNil( b:set( string.rep( str, 1000 ) ) );
+ifNotEqual( b:crc32(), b:crc32( 4501, -1, b:crc32( 1, 4500 ) ) );
+ifNotEqual( b:crc32c(), b:crc32c( 4501, -1, b:crc32c( 1, 4500 ) ) );
+
+-- incremental
+ifNotNil( b:set( '' ) );
+for c in str:gmatch( '...' ) do
+    ifNotNil( b:add( c ) );
+    ifNotEqual( b:crc32cstream(), b:crc32c() );
+end
+ifNotEqual( b:crc32cstream(), 0xe3069283 );
+ifNotEqual( b:adler32stream(), 0x091e01de );
+ifNotNil( b:set( '12345' ) );
+ifNotEqual( b:adler32stream(), b:adler32() );
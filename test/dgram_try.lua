@@ -0,0 +1,33 @@
+local buffer = require('buffer');
+-- descriptor that is not opened
+local b = ifNil( buffer.new( 8, 9999 ) );
+local n, err, again;
+
+ifNotEqual( b:messages(), 0 );
+ifNotNil( b:message( 1 ) );
+
+n, err, again = b:recvmany( 16, 512 );
+ifNotEqual( n, -1 );
+ifNil( err );
+ifNotFalse( again );
+ifNotEqual( b:messages(), 0 );
+ifNotEqual( #b, 0 );
+
+-- nothing to send
+ifNotEqual( b:sendmany(), 0 );
+ifNotNil( b:set( 'hello world' ) );
+n, err, again = b:sendmany( { 1, 5, 7, 11 } );
+ifNotEqual( n, -1 );
+ifNil( err );
+ifNotFalse( again );
+
+-- invalid arguments
+ifTrue( pcall( b.recvmany, b ) );
+ifTrue( pcall( b.recvmany, b, 0, 512 ) );
+ifTrue( pcall( b.recvmany, b, 1025, 512 ) );
+ifTrue( pcall( b.recvmany, b, 16, 0 ) );
+ifTrue( pcall( b.sendmany, b, 1 ) );
+ifTrue( pcall( b.sendmany, b, { 0, 5 } ) );
+ifTrue( pcall( b.sendmany, b, { 1, 12 } ) );
+ifTrue( pcall( b.sendmany, b, { 3, 1 } ) );
+ifTrue( pcall( b.message, b ) );
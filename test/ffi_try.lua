@@ -0,0 +1,43 @@
+local buffer = require('buffer');
+local bffi = require('buffer.ffi');
+local b = ifNil( buffer.new( 4 ) );
+
+ifNotNil( b:set( 'abc' ) );
+ifNotEqual( bffi.len( b ), 3 );
+ifNotEqual( bffi.byte( b ), 0x61 );
+ifNotEqual( bffi.byte( b, 3 ), 0x63 );
+ifNotNil( bffi.byte( b, 0 ) );
+ifNotNil( bffi.byte( b, 4 ) );
+
+-- append in place and grow
+ifNotNil( bffi.add( b, 'd' ) );
+ifNotNil( bffi.add( b, 'efgh' ) );
+ifNotEqual( tostring( b ), 'abcdefgh' );
+ifNotEqual( bffi.len( b ), #b );
+if bffi.enabled then
+    ifNotEqual( bffi.ptr( b ).mem[8], 0 );
+end
+
+-- the bytes are counted to the watermarks
+b = ifNil( buffer.new( 1024 ) );
+local base = buffer.pending();
+local len, above;
+ifNotFalse( b:watermark( 50, 100 ) );
+ifNotNil( bffi.add( b, string.rep( 'x', 200 ) ) );
+ifNotTrue( select( 2, bffi.add( b, 'y' ) ) );
+len, above = b:pending();
+ifNotEqual( len, 201 );
+ifNotTrue( above );
+ifNotEqual( buffer.pending(), base + 201 );
+
+-- invalid arguments
+ifTrue( pcall( bffi.len, 'abc' ) );
+b:free();
+ifNotEqual( buffer.pending(), base );
+ifTrue( pcall( bffi.byte, b ) );
+
+-- byte does not overflow the stack
+b = ifNil( buffer.new( 4096 ) );
+ifNotNil( b:set( string.rep( 'x', 100000 ) ) );
+ifNotEqual( select( '#', b:byte( 1, 1000 ) ), 1000 );
+ifTrue( pcall( b.byte, b, 1, 100000 ) );
@@ -0,0 +1,69 @@
+local buffer = require('buffer');
+-- descriptor that is not opened
+local w = ifNil( buffer.logwriter( 9999, { max_delay = 1000, max_bytes = 8 } ) );
+local called = 0;
+local seq, due, n, err;
+
+local function callback()
+    called = called + 1;
+end
+
+-- records are staged
+seq, due = w:append( 'abc', callback );
+ifNotEqual( seq, 1 );
+ifNotFalse( due );
+seq, due = w:append( ifNil( buffer.new( 8 ) ) );
+ifNotEqual( seq, 2 );
+ifNotFalse( due );
+n = w:pending();
+ifNotEqual( n, 2 );
+-- not due yet
+ifNotEqual( w:commit(), 0 );
+seq, due = w:append( 'defghi' );
+ifNotEqual( seq, 3 );
+ifNotTrue( due );
+n, err = w:pending();
+ifNotEqual( n, 3 );
+ifNotEqual( err, 9 );
+
+-- failed to write
+n, err = w:commit();
+ifNotNil( n );
+ifNil( err );
+ifNotEqual( called, 0 );
+ifNotEqual( w:durable(), 0 );
+ifNotEqual( w:pending(), 3 );
+n, err = w:close();
+ifNotNil( n );
+ifNil( err );
+
+-- failed to sync. the records are not durable
+w = ifNil( buffer.logwriter( 9999 ) );
+called = nil;
+ifNotEqual( w:append( '', function( _, e )
+    called = e;
+end ), 1 );
+n, err = w:commit( true );
+ifNotNil( n );
+ifNil( err );
+ifNil( called );
+n, err = w:durable();
+ifNotNil( n );
+ifNil( err );
+n, err = w:append( 'abc' );
+ifNotNil( n );
+ifNil( err );
+n, err = w:commit( true );
+ifNotNil( n );
+ifNil( err );
+
+-- invalid arguments
+ifTrue( pcall( w.append, w ) );
+ifTrue( pcall( w.append, w, 'abc', 1 ) );
+ifTrue( pcall( buffer.logwriter ) );
+ifTrue( pcall( buffer.logwriter, -1 ) );
+ifTrue( pcall( buffer.logwriter, 1, { max_delay = -1 } ) );
+ifTrue( pcall( buffer.logwriter, 1, { max_bytes = -1 } ) );
+ifTrue( pcall( buffer.logwriter, 1, { prealloc = -1 } ) );
+-- the size of the file is required for prealloc
+ifNotNil( buffer.logwriter( 9999, { prealloc = 4096 } ) );
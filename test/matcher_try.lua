@@ -0,0 +1,176 @@
+local buffer = require('buffer');
+local m = ifNil( buffer.matcher( { 'he', 'she', 'his', 'hers' } ) );
+local b = ifNil( buffer.new( 8 ) );
+local dst = ifNil( buffer.new( 8 ) );
+local res;
+
+-- invalid patterns
+ifTrue( pcall( buffer.matcher, {} ) );
+ifTrue( pcall( buffer.matcher, { 'a', '' } ) );
+ifTrue( pcall( buffer.matcher, { 'a', 1 } ) );
+
+-- find_all: earliest-ending match, restart after a match
+ifNotNil( b:set( 'ushers his' ) );
+res = m:find_all( b );
+ifNotEqual( #res, 2 );
+ifNotEqual( table.concat( res[1], ',' ), '2,4,2' );
+ifNotEqual( table.concat( res[2], ',' ), '8,10,3' );
+
+-- stream positions across chunks
+ifNotNil( b:set( 'ush' ) );
+ifNotEqual( #m:find_all( b, true ), 0 );
+ifNotNil( b:set( 'ers' ) );
+res = m:find_all( b );
+ifNotEqual( table.concat( res[1], ',' ), '2,4,2' );
+-- reset
+ifNotNil( b:set( 'sh' ) );
+ifNotEqual( #m:find_all( b, true ), 0 );
+m:reset();
+ifNotNil( b:set( 'e' ) );
+ifNotEqual( #m:find_all( b ), 0 );
+
+-- replace with a string
+ifNotNil( b:set( 'ushers his' ) );
+ifNotEqual( m:replace( b, dst, '*' ), 2 );
+ifNotEqual( tostring( dst ), 'u*rs *' );
+-- replace with a table
+ifNotNil( dst:set( '>' ) );
+ifNotEqual( m:replace( b, dst, { 'HE', 'SHE', 'HIS' } ), 2 );
+ifNotEqual( tostring( dst ), '>uSHErs HIS' );
+-- nil entry keeps the match
+dst:free();
+dst = ifNil( buffer.new( 8 ) );
+ifNotEqual( m:replace( b, dst, { 'HE', nil, 'HIS' } ), 1 );
+ifNotEqual( tostring( dst ), 'ushers HIS' );
+ifTrue( pcall( m.replace, m, b, b, '*' ) );
+ifTrue( pcall( m.replace, m, b, dst ) );
+
+-- streaming replace holds back the prefix of a match
+dst:free();
+dst = ifNil( buffer.new( 8 ) );
+ifNotNil( b:set( 'a hi' ) );
+ifNotEqual( m:replace( b, dst, '*', true ), 0 );
+ifNotEqual( tostring( dst ), 'a ' );
+ifNotNil( b:set( 's and s' ) );
+ifNotEqual( m:replace( b, dst, '*', true ), 1 );
+ifNotEqual( tostring( dst ), 'a * and ' );
+ifNotNil( b:set( 'o' ) );
+ifNotEqual( m:replace( b, dst, '*' ), 0 );
+ifNotEqual( tostring( dst ), 'a * and so' );
+
+-- streaming replace equals the replace of the whole input
+local function reference( pats, str, repl )
+    local out = {};
+    local pos = 1;
+    local i = 1;
+
+    while i <= #str do
+        local found;
+
+        -- earliest-ending match, longest pattern at that end
+        for _, pat in ipairs( pats ) do
+            local head = i - #pat + 1;
+            if head >= pos and str:sub( head, i ) == pat and
+               ( not found or #pat > #found ) then
+                found = pat;
+            end
+        end
+        if found then
+            out[#out + 1] = str:sub( pos, i - #found ) .. repl;
+            pos = i + 1;
+        end
+        i = i + 1;
+    end
+    out[#out + 1] = str:sub( pos );
+
+    return table.concat( out );
+end
+
+local pats = { 'ab', 'abab', 'bba', 'b', 'aaa' };
+local chars = { 'a', 'b', 'c' };
+m = ifNil( buffer.matcher( pats ) );
+math.randomseed( 1 );
+for _ = 1, 200 do
+    local src = {};
+    local str, pos;
+
+    for i = 1, math.random( 0, 40 ) do
+        src[i] = chars[math.random( #chars )];
+    end
+    str = table.concat( src );
+    dst:free();
+    dst = ifNil( buffer.new( 8 ) );
+    pos = 1;
+    while pos <= #str do
+        local len = math.random( 1, 6 );
+        ifNotNil( b:set( str:sub( pos, pos + len - 1 ) ) );
+        ifNil( m:replace( b, dst, '<>', true ) );
+        pos = pos + len;
+    end
+    ifNotNil( b:set( '' ) );
+    ifNil( m:replace( b, dst, '<>' ) );
+    ifNotEqual( tostring( dst ), reference( pats, str, '<>' ) );
+end
+
+-- the chunks appended to the same buffer
+m = ifNil( buffer.matcher( pats ) );
+for _ = 1, 100 do
+    local src = {};
+    local str, pos, found, res;
+
+    for i = 1, math.random( 0, 40 ) do
+        src[i] = chars[math.random( #chars )];
+    end
+    str = table.concat( src );
+    dst:free();
+    dst = ifNil( buffer.new( 8 ) );
+    ifNotNil( b:set( '' ) );
+    found = {};
+    pos = 1;
+    while pos <= #str do
+        local len = math.random( 1, 6 );
+        ifNotNil( b:add( str:sub( pos, pos + len - 1 ) ) );
+        ifNil( m:replace( b, dst, '<>', true ) );
+        pos = pos + len;
+    end
+    ifNil( m:replace( b, dst, '<>' ) );
+    ifNotEqual( tostring( dst ), reference( pats, str, '<>' ) );
+    ifNotEqual( tostring( b ), str );
+    -- find_all reports the same positions as the whole input
+    ifNotNil( b:set( '' ) );
+    pos = 1;
+    while pos <= #str do
+        local len = math.random( 1, 6 );
+        ifNotNil( b:add( str:sub( pos, pos + len - 1 ) ) );
+        for _, v in ipairs( m:find_all( b, true ) ) do
+            found[#found + 1] = table.concat( v, ',' );
+        end
+        pos = pos + len;
+    end
+    for _, v in ipairs( m:find_all( b ) ) do
+        found[#found + 1] = table.concat( v, ',' );
+    end
+    res = {};
+    for _, v in ipairs( m:find_all( b ) ) do
+        res[#res + 1] = table.concat( v, ',' );
+    end
+    ifNotEqual( table.concat( found, ' ' ), table.concat( res, ' ' ) );
+end
+
+-- a match that starts inside the held-back bytes
+m = ifNil( buffer.matcher( { 'abcx', 'bcy' } ) );
+dst:free();
+dst = ifNil( buffer.new( 8 ) );
+ifNotNil( b:set( 'abcy' ) );
+ifNotEqual( m:replace( b, dst, { '1', '2' } ), 1 );
+ifNotEqual( tostring( dst ), 'a2' );
+dst:free();
+dst = ifNil( buffer.new( 8 ) );
+ifNotNil( b:set( 'abc' ) );
+ifNotEqual( m:replace( b, dst, { '1', '2' }, true ), 0 );
+ifNotNil( b:set( 'y' ) );
+ifNotEqual( m:replace( b, dst, { '1', '2' } ), 1 );
+ifNotEqual( tostring( dst ), 'a2' );
+
+m = nil;
+collectgarbage('collect');
@@ -0,0 +1,111 @@
+local buffer = require('buffer');
+local b = ifNil( buffer.new( 8 ) );
+local req = {};
+local head = 'GET /index.html?q=1 HTTP/1.1\r\n' ..
+             'Host: example.com\r\n' ..
+             'Accept:  */*  \r\n' ..
+             'X-Empty:\r\n' ..
+             '\r\n';
+local len, err, again;
+
+local function field( i )
+    local h = req.headers;
+    local n = ( i - 1 ) * 4;
+
+    return b:sub( h[n + 1], h[n + 2] ), b:sub( h[n + 3], h[n + 4] );
+end
+
+-- request
+ifNotNil( b:set( head .. 'body' ) );
+len = ifNil( b:parsehttp( req ) );
+ifNotEqual( len, #head );
+ifNotEqual( req.method, 'GET' );
+ifNotEqual( req.path, '/index.html?q=1' );
+ifNotEqual( req.version, 1.1 );
+ifNotNil( req.status );
+ifNotEqual( req.nheader, 3 );
+ifNotEqual( table.concat( { field( 1 ) }, '=' ), 'Host=example.com' );
+ifNotEqual( table.concat( { field( 2 ) }, '=' ), 'Accept=*/*' );
+ifNotEqual( table.concat( { field( 3 ) }, '=' ), 'X-Empty=' );
+
+-- resume after the incomplete head
+ifNotNil( b:set( '' ) );
+for i = 1, #head do
+    ifNotNil( b:add( head:sub( i, i ) ) );
+    len, err, again = b:parsehttp( req );
+    if i < #head then
+        ifNotNil( len );
+        ifNotNil( err );
+        ifNotTrue( again );
+    end
+end
+ifNotEqual( len, #head );
+ifNotEqual( req.path, '/index.html?q=1' );
+-- bare LF and the leading empty lines
+ifNotNil( b:set( '\r\nPOST / HTTP/1.0\nContent-Length: 3\n\nabc' ) );
+ifNotEqual( b:parsehttp( req ), 37 );
+ifNotEqual( req.method, 'POST' );
+ifNotEqual( req.version, 1.0 );
+ifNotEqual( req.nheader, 1 );
+ifNotEqual( #req.headers, 4 );
+-- rewritten contents are scanned from the head
+ifNotNil( b:set( 'GET / HTTP/1.1\r\n' ) );
+ifNil( select( 3, b:parsehttp( req ) ) );
+ifNotNil( b:set( 'GET /x HTTP/1.1\r\n\r\n' ) );
+ifNotEqual( b:parsehttp( req ), 19 );
+ifNotEqual( req.path, '/x' );
+ifNotEqual( req.nheader, 0 );
+ifNotNil( next( req.headers ) );
+-- long target and value
+ifNotNil( b:set( 'GET /' .. ('a'):rep( 40 ) .. '\tb HTTP/1.1\r\n\r\n' ) );
+ifNotNil( b:parsehttp( req ) );
+ifNotNil( b:set( 'GET /' .. ('a'):rep( 40 ) .. ' HTTP/1.1\r\nX: ' ..
+                 ('v'):rep( 40 ) .. '\1\r\n\r\n' ) );
+ifNotNil( b:parsehttp( req ) );
+ifNotNil( b:set( 'GET /' .. ('a'):rep( 40 ) .. ' HTTP/1.1\r\nX: ' ..
+                 ('v\t'):rep( 20 ) .. '\r\n\r\n' ) );
+ifNil( b:parsehttp( req ) );
+ifNotEqual( req.path, '/' .. ('a'):rep( 40 ) );
+ifNotEqual( b:sub( req.headers[3], req.headers[4] ), ('v\t'):rep( 19 ) .. 'v' );
+
+-- response
+ifNotNil( b:set( 'HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n' ) );
+ifNil( b:parsehttp( req ) );
+ifNotNil( req.method );
+ifNotEqual( req.status, 404 );
+ifNotEqual( req.reason, 'Not Found' );
+ifNotEqual( req.nheader, 1 );
+ifNotNil( b:set( 'HTTP/1.0 204\r\n\r\n' ) );
+ifNil( b:parsehttp( req ) );
+ifNotEqual( req.status, 204 );
+ifNotEqual( req.reason, '' );
+
+-- malformed
+for _, v in ipairs({
+    'GET  / HTTP/1.1\r\n\r\n',
+    'GET / HTTP/2.0\r\n\r\n',
+    'GET /a b HTTP/1.1\r\n\r\n',
+    'G(T / HTTP/1.1\r\n\r\n',
+    'GET / HTTP/1.1\r\nHost : x\r\n\r\n',
+    'GET / HTTP/1.1\r\nHost: x\r\n folded\r\n\r\n',
+    'GET / HTTP/1.1\r\nHost: x\1y\r\n\r\n',
+    'HTTP/1.1 20 OK\r\n\r\n',
+    'HTTP/1.1 200OK\r\n\r\n'
+}) do
+    ifNotNil( b:set( v ) );
+    len, err = b:parsehttp( req );
+    ifNotNil( len );
+    ifNil( err );
+end
+ifTrue( pcall( b.parsehttp, b ) );
+
+-- the long path and values scanned by SIMD
+local path = '/' .. string.rep( 'abcdefgh', 20 );
+local value = string.rep( 'v a\tl', 30 );
+ifNotNil( b:set( 'GET ' .. path .. ' HTTP/1.1\r\nX-Long: ' .. value ..
+                 '\r\n\r\n' ) );
+ifNil( b:parsehttp( req ) );
+ifNotEqual( req.path, path );
+ifNotEqual( select( 2, field( 1 ) ), value );
+ifNotNil( b:set( 'GET ' .. path .. '\127 HTTP/1.1\r\n\r\n' ) );
+ifNotNil( b:parsehttp( req ) );
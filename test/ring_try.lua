@@ -0,0 +1,49 @@
+local buffer = require('buffer');
+local r = ifNil( buffer.ring( 10 ) );
+local b = ifNil( buffer.new( 8 ) );
+local len, err, again;
+
+-- capacity is rounded up to the power of 2
+ifNotEqual( r:cap(), 16 );
+ifNotEqual( #r, 0 );
+
+-- empty
+len, err, again = r:pop( b );
+ifNotEqual( len, -1 );
+ifNil( err );
+ifNotTrue( again );
+
+-- push/pop
+ifNotEqual( r:push( 'hello world' ), 11 );
+ifNotEqual( r:pop( b, 6 ), 6 );
+ifNotEqual( tostring( b ), 'hello ' );
+-- wrap around
+ifNotEqual( r:push( '0123456789abcdef' ), 11 );
+ifNotEqual( r:len(), 16 );
+len, err, again = r:push( 'x' );
+ifNotEqual( len, -1 );
+ifNotTrue( again );
+ifNotEqual( r:pop( b ), 16 );
+ifNotEqual( tostring( b ), 'hello world0123456789a' );
+
+-- push buffer
+ifNotEqual( r:push( b ), 16 );
+b:set( '' );
+ifNotEqual( r:pop( b ), 16 );
+ifNotEqual( tostring( b ), 'hello world01234' );
+
+-- open from handle
+local handle = r:handle();
+local r2 = ifNil( buffer.ring( handle ) );
+-- the handle is opened only once
+ifNotNil( buffer.ring( handle ) );
+-- not a handle of a ring
+ifNotNil( buffer.ring( ( b:raw() ) ) );
+ifNotEqual( r:push( 'shared' ), 6 );
+r:close();
+ifNotEqual( r2:len(), 6 );
+b:set( '' );
+ifNotEqual( r2:pop( b ), 6 );
+ifNotEqual( tostring( b ), 'shared' );
+r2:close();
+ifTrue( pcall( r2.len, r2 ) );
@@ -0,0 +1,65 @@
+local buffer = require('buffer');
+local b = ifNil( buffer.new( 8 ) );
+
+-- erase
+ifNotNil( b:set( 'hello world' ) );
+ifNotNil( b:erase( 6, 6 ) );
+ifNotEqual( tostring( b ), 'helloworld' );
+ifNotNil( b:erase( -5 ) );
+ifNotEqual( tostring( b ), 'hello' );
+ifNotNil( b:erase( 3, 2 ) );
+ifNotEqual( tostring( b ), 'hello' );
+ifNotNil( b:erase() );
+ifNotEqual( tostring( b ), '' );
+
+-- replace
+ifNotNil( b:set( 'hello world' ) );
+ifNotNil( b:replace( 1, 5, 'goodbye' ) );
+ifNotEqual( tostring( b ), 'goodbye world' );
+ifNotNil( b:replace( -5, -1, 'lua' ) );
+ifNotEqual( tostring( b ), 'goodbye lua' );
+-- insertion with the empty range
+ifNotNil( b:replace( 8, 7, ',' ) );
+ifNotEqual( tostring( b ), 'goodbye, lua' );
+ifNotNil( b:replace( 100, 100, '!' ) );
+ifNotEqual( tostring( b ), 'goodbye, lua!' );
+
+-- splice
+local str = 'Host: example.com\r\nCookie: secret\r\nX-Id: 1\r\n';
+local edits = {
+    { 7, 17, 'backend.local' },
+    { 28, 33, '***' },
+    { 36, 44 },
+    { 100, 0, 'Via: proxy\r\n' }
+};
+local expect = str:sub( 1, 6 ) .. 'backend.local' .. str:sub( 18, 27 ) ..
+               '***' .. str:sub( 34, 35 ) .. 'Via: proxy\r\n';
+
+ifNotNil( b:set( str ) );
+ifNotNil( b:splice( edits ) );
+ifNotEqual( tostring( b ), expect );
+ifNotEqual( #b, #expect );
+
+-- grow and shrink in a batch
+local src = {};
+local dst = {};
+edits = {};
+for i = 1, 100 do
+    src[i] = string.format( '%03d', i );
+    if i % 2 == 0 then
+        edits[#edits + 1] = { i * 3 - 2, i * 3, string.rep( 'x', i % 7 ) };
+        dst[i] = string.rep( 'x', i % 7 );
+    else
+        dst[i] = src[i];
+    end
+end
+ifNotNil( b:set( table.concat( src ) ) );
+ifNotNil( b:splice( edits ) );
+ifNotEqual( tostring( b ), table.concat( dst ) );
+
+-- invalid edits
+ifNotNil( b:set( 'abcdef' ) );
+ifTrue( pcall( b.splice, b, { { 3, 4 }, { 1, 2 } } ) );
+ifTrue( pcall( b.splice, b, { { 1, 4 }, { 3, 5 } } ) );
+ifTrue( pcall( b.splice, b, { { 1, 2, 3 } } ) );
+ifNotEqual( tostring( b ), 'abcdef' );
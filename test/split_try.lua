@@ -0,0 +1,83 @@
+local buffer = require('buffer');
+local b = ifNil( buffer.new( 8 ) );
+local res;
+
+local function collect( iter )
+    local list = {};
+
+    for head, tail in iter do
+        list[#list + 1] = b:sub( head, tail );
+    end
+
+    return list;
+end
+
+-- split
+ifNotNil( b:set( 'a,bc,,d' ) );
+res = collect( b:split(',') );
+ifNotEqual( table.concat( res, '|' ), 'a|bc||d' );
+ifNotEqual( b:count(','), 3 );
+ifNotNil( b:set( 'GET / HTTP/1.1\r\nHost: x\r\n\r\n' ) );
+res = collect( b:split('\r\n') );
+ifNotEqual( #res, 4 );
+ifNotEqual( res[2], 'Host: x' );
+ifNotEqual( res[4], '' );
+ifNotEqual( b:count('\r\n'), 3 );
+-- no delimiter
+ifNotNil( b:set( 'abc' ) );
+ifNotEqual( table.concat( collect( b:split(',') ), '|' ), 'abc' );
+ifNotEqual( b:count(','), 0 );
+ifNotEqual( b:sub( 3, 3 ), 'c' );
+ifNotNil( b:set( '' ) );
+ifNotEqual( #collect( b:split(',') ), 1 );
+ifTrue( pcall( b.split, b, '' ) );
+ifTrue( pcall( b.count, b, '' ) );
+-- non-overlapping
+ifNotNil( b:set( 'aaaa' ) );
+ifNotEqual( b:count('aa'), 2 );
+ifNotEqual( table.concat( collect( b:split('aa') ), '|' ), '||' );
+
+-- tokens
+ifNotNil( b:set( '  foo \t bar\nbaz  ' ) );
+res = collect( b:tokens(' \t\n') );
+ifNotEqual( table.concat( res, '|' ), 'foo|bar|baz' );
+ifNotNil( b:set( ' \t ' ) );
+ifNotEqual( #collect( b:tokens(' \t') ), 0 );
+ifTrue( pcall( b.tokens, b, '' ) );
+
+-- the long contents scanned by SIMD
+local words = {};
+for i = 1, 200 do
+    words[i] = string.rep( string.char( 97 + i % 26 ), i % 37 );
+end
+ifNotNil( b:set( table.concat( words, ',' ) ) );
+ifNotEqual( b:count(','), 199 );
+ifNotEqual( table.concat( collect( b:split(',') ), ',' ), 
+            table.concat( words, ',' ) );
+ifNotNil( b:set( table.concat( words, ' ;\t' ) ) );
+res = {};
+for _, w in ipairs( words ) do
+    if #w > 0 then
+        res[#res + 1] = w;
+    end
+end
+ifNotEqual( table.concat( collect( b:tokens(';\t ') ), ',' ), 
+            table.concat( res, ',' ) );
+-- more than the separators compared by SIMD
+ifNotEqual( table.concat( collect( b:tokens(';\t xyz') ), ',' ), 
+            table.concat( res, ',' ):gsub( '[xyz]+,?', '' ):gsub( ',$', '' ) );
+
+-- truncated while iterating
+ifNotNil( b:set( 'a,b,c' ) );
+res = 0;
+for head, tail in b:split(',') do
+    res = res + 1;
+    b:set( '' );
+end
+ifNotEqual( res, 1 );
+
+-- freed while iterating
+ifNotNil( b:set( 'a,b' ) );
+res = b:split(',');
+b:free();
+ifTrue( pcall( res ) );
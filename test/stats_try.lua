@@ -0,0 +1,46 @@
+local buffer = require('buffer');
+local b = ifNil( buffer.new( 8 ) );
+local gstats = ifNil( buffer.stats() );
+local stats = ifNil( b:stats() );
+
+ifNotEqual( stats.realloc, 0 );
+ifNotEqual( stats.peak, 8 );
+ifNotEqual( stats.total, 8 );
+
+-- realloc
+ifNotNil( b:set( 'hello' ) );
+ifNotNil( b:add( ' world' ) );
+stats = b:stats();
+ifNotEqual( stats.realloc, 1 );
+ifNotEqual( stats.peak, b:total() );
+
+-- memmove and copies
+ifNotNil( b:insert( 1, '>' ) );
+ifNotEqual( b:stats().moved, 11 );
+ifNotEqual( b:sub( 2, 6 ), 'hello' );
+ifNotEqual( b:substr( 8, 5 ), 'world' );
+ifNotEqual( tostring( b ), '>hello world' );
+ifNotEqual( b:stats().copied, 22 );
+
+-- module-wide aggregate
+stats = buffer.stats();
+ifTrue( stats.realloc < gstats.realloc + 1 );
+ifTrue( stats.copied < gstats.copied + 22 );
+ifTrue( stats.peak < stats.total );
+stats.total = stats.total - b:total();
+b:free();
+ifNotEqual( buffer.stats().total, stats.total );
+
+-- histograms
+ifNotFalse( buffer.profile( true ) );
+ifNotTrue( buffer.profile() );
+stats = ifNil( buffer.histograms( true ) );
+for _, op in ipairs({ 'read', 'write' }) do
+    for _, k in ipairs({ 'nsec', 'bytes' }) do
+        ifNotEqual( type( stats[op][k][0] ), 'number' );
+        ifNotEqual( type( stats[op][k][495] ), 'number' );
+        ifNotNil( stats[op][k][496] );
+    end
+end
+ifNotEqual( buffer.histograms().write.nsec[1], 0 );
+ifNotTrue( buffer.profile( false ) );
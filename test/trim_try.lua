@@ -0,0 +1,65 @@
+local buffer = require('buffer');
+local b = ifNil( buffer.new( 16 ) );
+local c = ifNil( buffer.new( 16 ) );
+local nbuf, bytes;
+
+ifNotNil( b:set( string.rep( 'x', 10000 ) ) );
+ifNotNil( c:set( string.rep( 'y', 10000 ) ) );
+ifNotTrue( b:total() > 10000 );
+
+-- the buffers that are not empty are not shrunk
+nbuf, bytes = buffer.trim();
+ifNotEqual( b:total() > 10000, true );
+ifNotEqual( #b, 10000 );
+
+-- shrink to the maximum idle bytes
+ifNotNil( b:set( '' ) );
+nbuf, bytes = buffer.trim( 1000 );
+ifFalse( nbuf >= 1 );
+ifFalse( bytes >= 9000 );
+ifNotEqual( b:total(), 992 );
+ifNotEqual( c:total() > 10000, true );
+-- shrink to the low watermark or the unit size
+b:reclaim( 64, 128 );
+nbuf, bytes = buffer.trim();
+ifNotEqual( b:total(), 64 );
+c:set( '' );
+c:free();
+buffer.trim();
+
+-- the buffer can grow again
+ifNotNil( b:set( string.rep( 'z', 1000 ) ) );
+ifNotEqual( b:sub( 1000 ), 'z' );
+
+-- aligned buffer
+b = ifNil( buffer.new( 64, nil, nil, { align = 64 } ) );
+ifNotNil( b:set( string.rep( 'x', 10000 ) ) );
+ifNotNil( b:set( 'abc' ) );
+buffer.trim( 0 );
+ifNotTrue( b:total() > 64 );
+ifNotNil( b:set( '' ) );
+buffer.trim( 0 );
+ifNotEqual( b:total(), 64 );
+ifNotNil( b:set( 'abc' ) );
+ifNotEqual( tostring( b ), 'abc' );
+
+-- the uring flush shrinks the memory after the buffer is released
+do
+    local u = ifNil( buffer.uring( 1 ) );
+    -- nothing is written to the stderr
+    local w = ifNil( buffer.new( 16, 2 ) );
+
+    ifNotNil( w:set( string.rep( 'x', 10000 ) ) );
+    ifNotNil( w:set( '' ) );
+    w:reclaim( 64, 128 );
+    ifNotTrue( u:flush( w ) );
+    ifNotEqual( u:submit( 1 ), 1 );
+    ifNil( u:complete() );
+    ifNotEqual( w:total(), 64 );
+    u:close();
+end
+
+-- invalid arguments
+ifTrue( pcall( b.reclaim, b, -1 ) );
+ifTrue( pcall( b.reclaim, b, 100, 10 ) );
+ifTrue( pcall( buffer.trim, 'a' ) );
@@ -0,0 +1,121 @@
+local buffer = require('buffer');
+local u = ifNil( buffer.uring( 8 ) );
+-- descriptor that is not opened
+local b = ifNil( buffer.new( 8, 9999 ) );
+local w = ifNil( buffer.new( 8, 9999 ) );
+local backend = u:backend();
+local res;
+
+ifTrue( backend ~= 'io_uring' and backend ~= 'sync' );
+ifTrue( pcall( buffer.uring, 0 ) );
+ifTrue( pcall( u.read, u, b, -1 ) );
+
+-- queue, submit and complete
+ifNotNil( w:set( 'hello' ) );
+ifNotTrue( u:read( b ) );
+ifNotTrue( u:flush( w ) );
+ifNotEqual( u:pending(), 2 );
+-- the memory is pinned while pending
+ifTrue( pcall( b.free, b ) );
+ifNotNil( select( 2, w:insert( 1, string.rep( 'x', 100 ) ) ) );
+ifNotEqual( u:submit( 2 ), 2 );
+res = {};
+for _ = 1, 2 do
+    local buf, op, len, err, again = u:complete();
+
+    ifNil( buf );
+    ifNotEqual( len, -1 );
+    ifNil( err );
+    ifNotFalse( again );
+    res[op] = buf;
+end
+ifNotEqual( res.read, b );
+ifNotEqual( res.flush, w );
+ifNotNil( u:complete() );
+ifNotEqual( u:pending(), 0 );
+-- the contents are not changed by the errors
+ifNotEqual( tostring( w ), 'hello' );
+ifNotEqual( #b, 0 );
+ifNotNil( w:insert( 1, string.rep( 'x', 100 ) ) );
+
+-- the contents are not modified while the read is in flight
+ifNotNil( b:set( 'hdr:' ) );
+ifNotTrue( u:readadd( b, 4 ) );
+ifNil( b:add( 'XYZ' ) );
+ifNil( b:set( 'x' ) );
+ifNil( b:insert( 1, 'x' ) );
+ifNil( b:erase( 1 ) );
+ifNotEqual( b:read(), -1 );
+ifNotEqual( tostring( b ), 'hdr:' );
+-- the contents are replaced by the read
+u:submit( 1 );
+ifNil( u:complete() );
+ifNotTrue( u:read( b, 4 ) );
+ifNotEqual( tostring( b ), '' );
+ifNotEqual( #b, 0 );
+u:submit( 1 );
+ifNil( u:complete() );
+ifNotNil( b:set( 'hdr:' ) );
+ifNotTrue( u:readadd( b, 4 ) );
+-- only one operation is in flight for each buffer
+res = { u:readadd( b, 4 ) };
+ifNotNil( res[1] );
+ifNotTrue( res[3] );
+ifNotTrue( select( 3, u:flush( b ) ) );
+ifNotEqual( u:pending(), 1 );
+u:submit( 1 );
+ifNil( u:complete() );
+ifNotEqual( u:pending(), 0 );
+ifNotNil( b:add( 'XYZ' ) );
+ifNotEqual( tostring( b ), 'hdr:XYZ' );
+
+-- the contents after the flushed bytes can be appended
+ifNotTrue( u:flush( w ) );
+ifNotNil( w:add( '!' ) );
+ifNil( w:insert( 1, '>' ) );
+ifNotEqual( w:flush(), -1 );
+u:submit( 1 );
+ifNil( u:complete() );
+ifNotNil( w:insert( 1, '>' ) );
+
+-- all slots are in use
+res = {};
+while true do
+    local buf = ifNil( buffer.new( 8, 9999 ) );
+
+    if not u:readadd( buf, 1 ) then
+        ifNotTrue( select( 3, u:readadd( buf, 1 ) ) );
+        break;
+    end
+    res[#res + 1] = buf;
+end
+ifNotEqual( u:pending(), #res );
+u:submit();
+ifNil( u:submit( #res ) );
+res = #res;
+while u:complete() do
+    res = res - 1;
+end
+ifNotEqual( res, 0 );
+ifNotEqual( u:pending(), 0 );
+
+-- fixed files and registered buffers
+ifNotTrue( u:files( { 0, 1, 2 } ) );
+ifTrue( pcall( u.files, u, { -1 } ) );
+ifTrue( pcall( u.register, u, { 'foo' } ) );
+ifNotTrue( u:files( {} ) );
+
+-- close cancels the pending operations
+ifNotTrue( u:read( b ) );
+u:close();
+ifTrue( pcall( u.pending, u ) );
+ifNotNil( b:free() );
+
+-- collected with the pending operations
+u = ifNil( buffer.uring( 1 ) );
+b = ifNil( buffer.new( 8, 9999 ) );
+ifNotTrue( u:read( b ) );
+u = nil;
+b = nil;
+collectgarbage('collect');
+collectgarbage('collect');
@@ -0,0 +1,36 @@
+local buffer = require('buffer');
+local str = 'a b&c=d/~é<x>"\'' .. string.rep( 'abcdefghijklmnopqrstuvwxyz', 2 ) .. '?';
+local enc = 'a%20b%26c%3Dd%2F~%C3%A9%3Cx%3E%22%27' .. 
+            string.rep( 'abcdefghijklmnopqrstuvwxyz', 2 ) .. '%3F';
+local b = ifNil( buffer.new( 10 ) );
+local dst = ifNil( buffer.new( 10 ) );
+
+-- in place
+ifNotNil( b:set( str ) );
+ifNotNil( b:urlencode() );
+ifNotEqual( tostring( b ), enc );
+ifNotNil( b:urldecode() );
+ifNotEqual( tostring( b ), str );
+
+-- append to destination
+ifNotNil( dst:set( 'q=' ) );
+ifNotNil( b:urlencodeform( dst ) );
+ifNotEqual( tostring( dst ), 'q=' .. enc:gsub( '%%20', '+' ) );
+ifNotNil( b:set( 'x+y%41' ) );
+ifNotNil( dst:set( '' ) );
+ifNotNil( b:urldecodeform( dst ) );
+ifNotEqual( tostring( dst ), 'x yA' );
+ifNotNil( b:urldecode( dst ) );
+ifNotEqual( tostring( dst ), 'x yAx+yA' );
+
+-- invalid sequence does not modify the contents
+ifNotNil( b:set( 'abc%4' ) );
+ifNil( b:urldecode() );
+ifNotEqual( tostring( b ), 'abc%4' );
+ifNil( b:urldecode( dst ) );
+ifNotEqual( tostring( dst ), 'x yAx+yA' );
+
+-- html
+ifNotNil( b:set( string.rep( '<a href="x">&\'</a>', 3 ) ) );
+ifNotNil( b:htmlescape() );
+ifNotEqual( tostring( b ), string.rep( '&lt;a href=&quot;x&quot;&gt;&amp;&#39;&lt;/a&gt;', 3 ) );
@@ -0,0 +1,40 @@
+local buffer = require('buffer');
+local str = string.rep( 'aあ€𠀋z', 10 );
+local b = ifNil( buffer.new( 10 ) );
+local ok, pos;
+
+ifNotNil( b:set( str ) );
+ifNotTrue( b:isutf8() );
+ifNotEqual( b:utf8len(), 50 );
+ifNotEqual( b:utf8len( 2, 4 ), 1 );
+
+-- invalid sequence
+ifNotNil( b:add( '\237\160\128' ) );
+ok, pos = b:isutf8();
+ifNotFalse( ok );
+ifNotEqual( pos, #str + 1 );
+ifNotNil( b:utf8len() );
+
+-- truncated sequence
+ifNotNil( b:set( str .. '\240\160' ) );
+ok, pos = b:isutf8();
+ifNotFalse( ok );
+ifNotEqual( pos, #str + 1 );
+ifNotTrue( b:isutf8( 1, #str ) );
+
+-- incremental validation
+ifNotNil( b:set( '' ) );
+for c in ( str .. str ):gmatch( '.' ) do
+    ifNotNil( b:add( c ) );
+    ifNotTrue( b:isutf8stream() );
+end
+ifNotTrue( b:isutf8stream( true ) );
+ifNotNil( b:add( '\226\130' ) );
+ifNotTrue( b:isutf8stream() );
+ok, pos = b:isutf8stream( true );
+ifNotFalse( ok );
+ifNotEqual( pos, #str * 2 + 1 );
+ifNotNil( b:set( 'abc\255' ) );
+ok, pos = b:isutf8stream();
+ifNotFalse( ok );
+ifNotEqual( pos, 4 );
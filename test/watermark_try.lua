@@ -0,0 +1,61 @@
+local buffer = require('buffer');
+-- descriptor that is not opened
+local b = ifNil( buffer.new( 16, 9999 ) );
+local c = ifNil( buffer.new( 16 ) );
+local base = buffer.pending();
+local err, above, len, again;
+
+-- not counted without the watermarks
+ifNotNil( c:add( 'hello' ) );
+ifNotEqual( buffer.pending(), base );
+ifNotEqual( select( '#', c:add( 'x' ) ), 0 );
+
+ifNotFalse( b:watermark( 4, 8 ) );
+err, above = b:add( 'abcd' );
+ifNotNil( err );
+ifNotFalse( above );
+ifNotEqual( buffer.pending(), base + 4 );
+err, above = b:add( 'efghi' );
+ifNotTrue( above );
+len, above = b:pending();
+ifNotEqual( len, 9 );
+ifNotTrue( above );
+ifNotEqual( buffer.pending(), base + 9 );
+
+-- hysteresis: above until the pending bytes decrease to the low watermark
+ifNotNil( b:set( 'abcdef' ) );
+ifNotTrue( select( 2, b:pending() ) );
+ifNotNil( b:set( 'abcd' ) );
+ifNotFalse( select( 2, b:pending() ) );
+ifNotEqual( buffer.pending(), base + 4 );
+
+-- write queues the contents after the pending contents
+len, err, again, above = b:write( 'xyz' );
+ifNotEqual( len, 0 );
+ifNotNil( err );
+ifNotFalse( again );
+ifNotFalse( above );
+ifNotEqual( tostring( b ), 'abcdxyz' );
+ifNotEqual( buffer.pending(), base + 7 );
+-- write failure of the empty buffer
+ifNotNil( b:set( '' ) );
+len, err = b:write( 'xyz' );
+ifNotEqual( len, -1 );
+ifNil( err );
+ifNotEqual( #b, 0 );
+
+-- disable the watermarks
+ifNotNil( b:add( 'abc' ) );
+ifNotFalse( b:watermark() );
+ifNotEqual( buffer.pending(), base );
+ifNotEqual( select( '#', b:add( 'x' ) ), 0 );
+
+-- released by free
+b:watermark( 0, 1 );
+ifNotEqual( buffer.pending(), base + 4 );
+b:free();
+ifNotEqual( buffer.pending(), base );
+
+-- invalid arguments
+ifTrue( pcall( c.watermark, c, -1 ) );
+ifTrue( pcall( c.watermark, c, 10, 5 ) );
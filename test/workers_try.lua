@@ -0,0 +1,44 @@
+local buffer = require('buffer');
+local b = ifNil( buffer.new( 4096 ) );
+local chunk = {};
+local serial = {};
+local parallel = {};
+local n, threshold;
+
+for i = 0, 255 do
+    chunk[#chunk + 1] = string.char( i );
+end
+chunk = table.concat( chunk );
+-- 3-byte unaligned contents
+ifNotNil( b:set( chunk:rep( 4100 ) .. 'abcde' ) );
+
+local function run( res )
+    res.lower = b:lower();
+    res.upper = b:upper();
+    res.hex = b:hex();
+    res.base64 = b:base64();
+    res.base64url = b:base64url();
+    res.crc32c = b:crc32c( 3, -1, 12345 );
+    res.crc32 = b:crc32( 3, -1, 12345 );
+    res.adler32 = b:adler32( 3, -1, 12345 );
+end
+
+-- serial
+n, threshold = buffer.workers( 0 );
+ifNotEqual( n, 0 );
+run( serial );
+ifNotEqual( serial.lower, tostring( b ):lower() );
+ifNotEqual( serial.upper, tostring( b ):upper() );
+
+-- parallel
+n, threshold = buffer.workers( 3, 1024 );
+ifNotEqual( n, 3 );
+ifNotEqual( threshold, 1024 );
+run( parallel );
+for k, v in pairs( serial ) do
+    ifNotEqual( parallel[k], v );
+end
+
+-- automatic
+ifNotEqual( buffer.workers( -1 ), -1 );
+ifTrue( pcall( buffer.workers, 1000 ) );
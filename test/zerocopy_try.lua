@@ -0,0 +1,30 @@
+local buffer = require('buffer');
+-- descriptor that is not opened
+local b = ifNil( buffer.new( 8, 9999 ) );
+local len, used, err, again;
+
+-- falls back to writev if the descriptor does not support zero-copy
+ifNotNil( b:set( string.rep( 'x', 65536 ) ) );
+len, used, err, again = b:flush({ zerocopy = true });
+ifNotEqual( len, -1 );
+ifNotEqual( used, 65536 );
+ifNil( err );
+ifNotFalse( again );
+ifTrue( pcall( b.flush, b, true ) );
+-- nothing to send
+ifNotNil( b:set( '' ) );
+len, used = b:flush({ zerocopy = true });
+ifNotEqual( len, 0 );
+ifNotEqual( used, 0 );
+
+-- sendfile and splice
+len, err, again = buffer.sendfile( 9999, 9998, 0, 10 );
+ifNotEqual( len, -1 );
+ifNil( err );
+ifNotFalse( again );
+ifTrue( pcall( buffer.sendfile, -1, 0, 0, 10 ) );
+ifTrue( pcall( buffer.sendfile, 1, 0, 0, -1 ) );
+len, err, again = buffer.splice( 9999, 9998, 10 );
+ifNotEqual( len, -1 );
+ifNil( err );
+ifTrue( pcall( buffer.splice, 1, -1, 10 ) );
@@ -0,0 +1,54 @@
+local buffer = require('buffer');
+local str = string.rep( 'hello world! ', 1000 );
+local b = ifNil( buffer.new( 100 ) );
+local z = ifNil( buffer.new( 100 ) );
+local d = ifNil( buffer.new( 100 ) );
+
+-- zlib format
+ifNotNil( d:set( '\120\156\203\72\205\201\201\87\40\207\47\202\73\1\0\26\11\4\93' ) );
+ifNotNil( d:inflate( b ) );
+ifNotEqual( tostring( b ), 'hello world' );
+
+-- one-shot
+for _, fmt in ipairs({ 'deflate', 'gzip', 'raw' }) do
+    ifNotNil( b:set( str ) );
+    ifNotNil( z:set( '' ) );
+    ifNotNil( d:set( 'prefix' ) );
+    ifNotNil( b:deflate( z, 9, fmt ) );
+    ifTrue( #z >= #str );
+    ifNotNil( z:inflate( d, fmt == 'raw' and 'raw' or nil ) );
+    ifNotEqual( tostring( d ), 'prefix' .. str );
+end
+
+-- truncated stream
+ifNotNil( z:set( tostring( z ):sub( 1, -5 ) ) );
+ifNotNil( d:set( 'prefix' ) );
+ifNil( z:inflate( d, 'raw' ) );
+ifNotEqual( tostring( d ), 'prefix' );
+
+-- streaming
+local def = ifNil( buffer.deflater( nil, 'gzip' ) );
+local inf = ifNil( buffer.inflater() );
+ifNotNil( z:set( '' ) );
+for i = 1, 10 do
+    ifNotNil( b:set( str ) );
+    ifNotNil( def:update( b, z ) );
+    ifNotEqual( #b, 0 );
+end
+ifNotNil( def:finish( b, z ) );
+ifNotNil( d:set( '' ) );
+ifNotNil( z:add( 'trailing' ) );
+while #z > 0 do
+    local chunk = tostring( z ):sub( 1, 100 );
+    ifNotNil( b:set( chunk ) );
+    ifNotNil( z:set( tostring( z ):sub( 101 ) ) );
+    local done, err = inf:update( b, d );
+    ifNotNil( err );
+    if done then
+        ifNotEqual( tostring( b ) .. tostring( z ), 'trailing' );
+        break;
+    end
+end
+ifNotEqual( tostring( d ), string.rep( str, 10 ) );
+def:close();
+inf:close();